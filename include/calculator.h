@@ -1,6 +1,6 @@
 /**
 * @note Класс реализующий консольный калькулятор с операциями /+*-!^()%
-* 
+*
 * Example:
 #include "calculator.h"
 #include <iostream>
@@ -8,242 +8,2025 @@ int main()
 {
 	Calculator<int> calc;
 	std::cout << calc("a=2") << std::endl;
-	std::cout << calc("b=3") << std::endl;		
+	std::cout << calc("b=3") << std::endl;
 	std::cout << calc("a*(b+2)") << std::endl;
-	
+
 	for (auto  it = calc.list_vars().begin; it != calc.list_vars().end; it++)
 	{
 		std::cout << it->first << "= " << it->second << std::endl;
 	}
+
+	// однократный разбор и многократное вычисление
+	Calculator<int>::program prog;
+	if (calc.compile("c = a*(b+2)", prog))
+	{
+		int slots[3];
+		slots[prog.slot("a")] = 4;
+		slots[prog.slot("b")] = 1;
+		std::cout << calc.eval(prog, slots) << std::endl;	// 12, slots[prog.slot("c")] == 12
+		std::cout << calc.eval(prog) << std::endl;			// 10, переменные калькулятора
+
+		// пакетное вычисление по столбцам
+		int a[4] = { 1,2,3,4 }, b[4] = { 0,0,1,1 }, c[4], res[4];
+		int* columns[3];
+		columns[prog.slot("a")] = a;
+		columns[prog.slot("b")] = b;
+		columns[prog.slot("c")] = c;	// присваиваемый слот
+		calc.eval_batch(prog, columns, res, 4);	// res = { 2,4,9,12 }
+
+		// одна программа, свой контекст переменных в каждом потоке
+		std::thread th([&]()
+		{
+			Calculator<int>::context ctx = calc.make_context();
+			ctx.set("b", 5);
+			ctx.eval(prog);		// 14, calc не изменяется
+		});
+		th.join();
+	}
+
+	// свёртка констант и общих подвыражений: (a+1)*(a+1) + 2^3 -> t*t + 8, t = a+1
+	if (calc.compile("(a+1)*(a+1) + 2^3", prog) && Calculator<int>::optimize(prog))
+		std::cout << calc.eval(prog) << std::endl;	// 17
+
+	// кэш разобранных выражений для часто повторяющихся строк
+	calc.set_cache_size(64);
+	calc("a*(b+2)");
+	calc("a*(b+2)");	// без разбора, cache_hits() == 1, cache_misses() == 1
+
+	// пересчёт только зависимых присваиваний
+	calc("c = a*(b+2)");
+	calc("d = c + 1");
+	calc.update("b", 0);	// c = 4, d = 5
+
+	// вычисление на сетке: a = 0..2 x b = 1..2 -> 6 значений, b меняется быстрее
+	Calculator<int>::axis axes[] = { Calculator<int>::axis::range("a", 0, 2, 1), Calculator<int>::axis::range("b", 1, 2, 1) };
+	int grid[6];
+	if (calc.compile("a*10 + b", prog))
+		calc.sweep(prog, axes, 2, grid);	// { 1,2,11,12,21,22 }
+
+	// текст из нескольких выражений одним вызовом
+	for (const auto& r : calc.eval_script("x = 2; y = x*3\nz = y $ 1"))
+		std::cout << r.index << ": " << r.value << " " << r.error << std::endl;	// 0: 2, 1: 6, 2: ERR_UNKNOWN
+
+	// вычисление при компиляции
+	constexpr calc_binding<int> consts[] = { { "a", 2 }, { "b", 3 } };
+	constexpr int k = calc_eval<int>("a*(b+2)", consts);	// 10
 }
 */
 #ifndef CALCULATOR_H
 #define CALCULATOR_H
 
-#include <map>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstring>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "math/simd_kernels.h"
 
-#define MAX_LENGHTH_VAR_NAME 80
+#define BATCH_BLOCK_SIZE 256 ///< число строк, обрабатываемых за один проход программы в eval_batch()
 
-static const char* err_msgs[5] = {
+#if !defined(CALC_NO_CONSTANT_EVALUATED) && defined(__cpp_lib_is_constant_evaluated)
+#define CALC_CONSTANT_EVALUATED() std::is_constant_evaluated()     ///< calc_eval() вычисляется при компиляции
+#elif !defined(CALC_NO_CONSTANT_EVALUATED) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1925))
+#define CALC_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+// момент вычисления не определить: calc_eval() и во время выполнения считает функциями calc_constexpr,
+// '^' и числа с плавающей точкой могут отличаться от Calculator<T> в последнем знаке (см. tests/calc_eval_fallback.cpp)
+#ifndef CALC_NO_CONSTANT_EVALUATED
+#define CALC_NO_CONSTANT_EVALUATED
+#endif
+#define CALC_CONSTANT_EVALUATED() true
+#endif
+
+static const char* err_msgs[6] = {
     "Broken balance brackets",
     "Unexpected end of expression",
     "Unexpected operator",
     "Overflow",
-    "Unknown symbol"
+    "Unknown symbol",
+    "Division by zero"
 };
 
-template <typename T>
-class Calculator
+namespace calc_token
 {
-public:
-    enum ERRORS { ERR_BAL, ERR_END, ERR_OP, ERR_OVER, ERR_UNKNOWN };
+    //! @brief классы символов выражения
+    enum CHAR_CLASS : uint8_t { CH_UNKNOWN = 0, CH_END, CH_SPACE, CH_DIGIT, CH_ALPHA, CH_OP };
 
-    class compcl
+    //! @brief таблица классов для всех 256 значений char, не зависит от локали
+    struct char_table
     {
-    public:
-        bool operator()(const char* a, const char* b) const
+        uint8_t cls[256];
+
+        //! @param script '\n' и ';' завершают выражение (см. Calculator::eval_script())
+        constexpr char_table(bool script = false) : cls()
         {
-            return strcmp(a, b) < 0;
+            cls[0] = CH_END;
+            for (const char* s = " \t\n\v\f\r"; *s; s++)
+                cls[(uint8_t)*s] = CH_SPACE;
+            for (int ch = '0'; ch <= '9'; ch++)
+                cls[ch] = CH_DIGIT;
+            for (int ch = 'a'; ch <= 'z'; ch++)
+            {
+                cls[ch] = CH_ALPHA;
+                cls[ch - 'a' + 'A'] = CH_ALPHA;
+            }
+            for (const char* s = "()!^*/%+-="; *s; s++)
+                cls[(uint8_t)*s] = CH_OP;
+            if (script)
+                cls['\n'] = cls[';'] = CH_END;
         }
+
+        constexpr uint8_t operator[](char ch) const { return cls[(uint8_t)ch]; }
     };
 
-private:
-    enum { NONE = 0, NUM, OP, VAR };
+    inline constexpr char_table classes{};
+    inline constexpr char_table script_classes{ true };
 
-    char token[MAX_LENGHTH_VAR_NAME];
-    char tok_type;
-    const char* exp;
+    /**
+     * @brief Значение токена из цифр и '.', как atof(), но без зависимости от локали
+     * @return false, если целое значение не представимо в T
+     */
+    template <typename T>
+    inline bool parse_number(const char* first, const char* last, T& value)
+    {
+        if constexpr (std::is_integral<T>::value)
+        {
+            value = 0;  //дробная часть отбрасывается
+            return std::from_chars(first, last, value).ec != std::errc::result_out_of_range;
+        }
+        else
+        {
+            double d = 0;   //число до второй '.'
+            if (std::from_chars(first, last, d).ec == std::errc::result_out_of_range)
+            {
+                //ненулевая цифра до '.' - переполнение, иначе потеря значимости
+                const char* dot = std::find(first, last, '.');
+                d = std::find_if(first, dot, [](char ch) { return ch != '0'; }) != dot ? std::numeric_limits<double>::infinity() : 0;
+            }
+            value = (T)d;
+            return true;
+        }
+    }
+} // namespace calc_token
 
-    std::map<const char*, T, compcl> vars;
-    char lastVar[MAX_LENGHTH_VAR_NAME];
+/**
+ * @brief Арифметика значений Calculator<T>
+ * @note Операции возвращают false, если результат не представим в T (переполнение, деление на 0).
+ * Свой тип значений подключается специализацией calc_traits (см. math/fixed_point.h)
+ */
+template <typename T, typename = void>
+struct calc_traits
+{
+    static constexpr bool vector = std::is_floating_point<T>::value;  ///< +-*/ выполняются ядрами simd_kernels.h
 
-    bool _was_error : 1;
-    int  _error_code : 7;
+    static inline bool add(T a, T b, T& r) { r = a + b; return true; }
+    static inline bool sub(T a, T b, T& r) { r = a - b; return true; }
+    static inline bool mul(T a, T b, T& r) { r = a * b; return true; }
+    static inline bool div(T a, T b, T& r) { r = a / b; return true; }
+    static inline bool neg(T a, T& r) { r = -a; return true; }
+    static inline bool mod(T a, T b, T& r) { r = (T)std::fmod(std::floor(a), std::floor(b)); return true; }
+    static inline bool pow(T a, T b, T& r) { r = (T)std::pow(a, b); return true; }
 
-    void next_token();
+    //! @note |a|!, младшие 64 бита: от 66! (а также для inf и NaN) они равны 0
+    static inline bool fact(T a, T& r)
+    {
+        const double n = std::fabs(std::floor((double)a));
+        uint64_t f = n < 66 ? 1 : 0;
+        for (uint64_t i = 2; i <= n && f; i++)
+            f *= i;
+        r = (T)f;
+        return true;
+    }
+};
 
-    void eval_exp5(T& result); // =
-    void eval_exp4(T& result); // + -
-    void eval_exp3(T& result); // * / %
-    void eval_exp2(T& result); // + - Унарные
-    void eval_exp1(T& result); // ^ !
-    void eval_exp0(T& result); // ( )
-    void atom(T& result);
-public:
-    Calculator();
+//! @brief Целые: проверка переполнения, возведение в степень умножениями, таблица факториалов
+template <typename T>
+struct calc_traits<T, typename std::enable_if<std::is_integral<T>::value>::type>
+{
+    static constexpr bool vector = false;
 
-    T operator()(const char* exp);
+    static constexpr bool add(T a, T b, T& r)
+    {
+#if defined(__GNUC__)
+        return !__builtin_add_overflow(a, b, &r);
+#else
+        if (b > 0 ? a > std::numeric_limits<T>::max() - b : a < std::numeric_limits<T>::min() - b)
+            return false;
+        r = a + b;
+        return true;
+#endif
+    }
 
-    inline bool was_error() { return _was_error; }
-    inline const char* error_message() { return err_msgs[_error_code]; }
+    static constexpr bool sub(T a, T b, T& r)
+    {
+#if defined(__GNUC__)
+        return !__builtin_sub_overflow(a, b, &r);
+#else
+        if (b > 0 ? a < std::numeric_limits<T>::min() + b : a > std::numeric_limits<T>::max() + b)
+            return false;
+        r = a - b;
+        return true;
+#endif
+    }
 
-    struct itr_range
-    {        
-       typename std::map<const char*, T, compcl>::const_iterator begin;
-       typename std::map<const char*, T, compcl>::const_iterator end;
-    };    
+    static constexpr bool mul(T a, T b, T& r)
+    {
+#if defined(__GNUC__)
+        return !__builtin_mul_overflow(a, b, &r);
+#else
+        if (is_min_by_minus_one(a, b) || is_min_by_minus_one(b, a))
+            return false;
+        typedef typename std::make_unsigned<T>::type U;
+        r = (T)((U)a * (U)b);
+        return a == 0 || r / a == b;
+#endif
+    }
 
-    inline const itr_range list_vars() const
+    static constexpr bool div(T a, T b, T& r)
     {
-        return {
-            vars.cbegin(),
-            vars.cend()
-        };
+        if (b == 0 || is_min_by_minus_one(a, b))
+            return false;
+        r = a / b;
+        return true;
+    }
+
+    static constexpr bool neg(T a, T& r) { return sub(0, a, r); }
+
+    static constexpr bool mod(T a, T b, T& r)
+    {
+        if (b == 0)
+            return false;
+        r = is_min_by_minus_one(a, b) ? 0 : a % b;
+        return true;
+    }
+
+    static constexpr bool pow(T a, T b, T& r)
+    {
+        if (b < 0)  //|a| > 1: дробный результат
+        {
+            if (a == 0)
+                return false;
+            r = a == 1 || (a == (T)-1 && b % 2 == 0) ? 1 : (a == (T)-1 ? (T)-1 : 0);
+            return true;
+        }
+
+        T res = 1;
+        for (;;)
+        {
+            if ((b & 1) && !mul(res, a, res))
+                return false;
+            b >>= 1;
+            if (!b)
+                break;
+            if (!mul(a, a, a))
+                return false;
+        }
+        r = res;
+        return true;
+    }
+
+    //! @note |a|!, больше max(T) - переполнение
+    static constexpr bool fact(T a, T& r)
+    {
+        const uint64_t n = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+        if (n > fact_max())
+            return false;
+        r = (T)factorials[n];
+        return true;
     }
 
 private:
-    inline uint64_t fact(int64_t a)
+    static constexpr uint64_t factorials[21] = {
+        1ull, 1ull, 2ull, 6ull, 24ull, 120ull, 720ull, 5040ull, 40320ull, 362880ull, 3628800ull,
+        39916800ull, 479001600ull, 6227020800ull, 87178291200ull, 1307674368000ull, 20922789888000ull,
+        355687428096000ull, 6402373705728000ull, 121645100408832000ull, 2432902008176640000ull
+    };
+
+    //! @brief наибольшее n, для которого n! представим в T
+    static constexpr uint64_t fact_max()
     {
-        if (a < 0)
-            throw ERR_OVER;
-        return a > 1 ? fact(a - 1) * a : 1;
+        uint64_t n = 0;
+        while (n + 1 < 21 && factorials[n + 1] <= (uint64_t)std::numeric_limits<T>::max())
+            n++;
+        return n;
+    }
+
+    static constexpr bool is_min_by_minus_one(T a, T b)
+    {
+        return std::is_signed<T>::value && a == std::numeric_limits<T>::min() && b == (T)-1;
     }
 };
-//=============================================================================================
-#include <cctype>
-#include <cstdlib>
-#include <cmath>
 
 template <typename T>
-Calculator<T>::Calculator()
+class Calculator
 {
-    tok_type = NONE;
-    exp = nullptr;
-    memset(lastVar, 0, sizeof(lastVar));
-    memset(token, 0, sizeof(token));
-    _was_error = false;
-    _error_code = ERR_UNKNOWN;
-}
+public:
+    enum ERRORS { ERR_NONE = -1, ERR_BAL, ERR_END, ERR_OP, ERR_OVER, ERR_UNKNOWN, ERR_DIV };
 
-template <typename T>
-void Calculator<T>::next_token()
-{    
-    auto isoperator{ [](int ch)
+    /**
+     * @brief Таблица имён переменных
+     * @note Имена хранятся блоками в общем буфере, каждой переменной выдаётся плотный номер,
+     * по которому значения хранятся в контексте (см. context). Поиск имени - открытая адресация по хэшу
+     */
+    class symbol_table
+    {
+    public:
+        symbol_table() : _arena_used(ARENA_BLOCK_SIZE) {}
+
+        symbol_table(const symbol_table& src) : _arena_used(ARENA_BLOCK_SIZE)
+        {
+            *this = src;
+        }
+
+        symbol_table& operator=(const symbol_table& src)
+        {
+            if (this != &src)
+            {
+                clear();
+                for (uint32_t id = 0; id < src.size(); id++)
+                {
+                    intern(src.name(id), strlen(src.name(id)));
+                }
+            }
+            return *this;
+        }
+
+        inline uint32_t size() const { return (uint32_t)_names.size(); }
+        inline const char* name(uint32_t id) const { return _names[id]; }
+
+        //! @return номер переменной или -1, если имя не встречалось
+        int find(const char* name, size_t len) const
+        {
+            if (_index.empty())
+                return -1;
+
+            const uint32_t mask = (uint32_t)_index.size() - 1;
+            for (uint32_t i = hash(name, len) & mask; _index[i]; i = (i + 1) & mask)
+            {
+                const uint32_t id = _index[i] - 1;
+                if (strncmp(_names[id], name, len) == 0 && _names[id][len] == 0)
+                    return (int)id;
+            }
+            return -1;
+        }
+
+        inline int find(const char* name) const { return find(name, strlen(name)); }
+
+        //! @brief Получить номер переменной, добавив её при необходимости
+        uint32_t intern(const char* name, size_t len)
+        {
+            int id = find(name, len);
+            if (id >= 0)
+                return (uint32_t)id;
+
+            if ((_names.size() + 1) * 2 > _index.size())
+                rehash(_index.empty() ? 16 : (uint32_t)_index.size() * 2);
+
+            char* str = alloc_name(len + 1);
+            memcpy(str, name, len);
+            str[len] = 0;
+
+            const uint32_t h = hash(name, len);
+            _names.push_back(str);
+            _hashes.push_back(h);
+            insert_index(h, size());
+            return size() - 1;
+        }
+
+        void clear()
+        {
+            _arena.clear();
+            _arena_used = ARENA_BLOCK_SIZE;
+            _names.clear();
+            _hashes.clear();
+            _index.clear();
+        }
+
+    private:
+        enum { ARENA_BLOCK_SIZE = 4096 };
+
+        static inline uint32_t hash(const char* str, size_t len)
+        {
+            uint32_t h = 2166136261u;   //FNV-1a
+            for (size_t i = 0; i < len; i++)
+            {
+                h = (h ^ (uint8_t)str[i]) * 16777619u;
+            }
+            return h;
+        }
+
+        char* alloc_name(size_t len)
+        {
+            if (len > ARENA_BLOCK_SIZE)     //длинное имя - отдельный блок перед текущим
+            {
+                char* ptr = new char[len];
+                _arena.emplace(_arena.empty() ? _arena.end() : _arena.end() - 1, ptr);
+                return ptr;
+            }
+            if (_arena_used + len > ARENA_BLOCK_SIZE)
+            {
+                _arena.emplace_back(new char[ARENA_BLOCK_SIZE]);
+                _arena_used = 0;
+            }
+            char* ptr = _arena.back().get() + _arena_used;
+            _arena_used += len;
+            return ptr;
+        }
+
+        void insert_index(uint32_t h, uint32_t id_1)
+        {
+            const uint32_t mask = (uint32_t)_index.size() - 1;
+            uint32_t i = h & mask;
+            while (_index[i])
+            {
+                i = (i + 1) & mask;
+            }
+            _index[i] = id_1;
+        }
+
+        void rehash(uint32_t new_size)
+        {
+            _index.assign(new_size, 0);
+            for (uint32_t id = 0; id < size(); id++)
+            {
+                insert_index(_hashes[id], id + 1);
+            }
+        }
+
+        std::vector<std::unique_ptr<char[]>> _arena;    ///< блоки памяти под имена
+        size_t _arena_used;                 ///< занято байт в последнем блоке
+        std::vector<const char*> _names;    ///< имена по номерам
+        std::vector<uint32_t> _hashes;      ///< хэши имён по номерам
+        std::vector<uint32_t> _index;       ///< хэш-таблица: номер переменной + 1, 0 - пусто
+    };
+
+    class context;
+
+    /// @brief Итератор по заданным переменным: it->first - имя, it->second - значение
+    class const_iterator
+    {
+    public:
+        struct value_type
+        {
+            const char* first;
+            T second;
+        };
+
+        const_iterator() : _ctx(nullptr), _id(0), _cur() {}
+        const_iterator(const context* ctx, uint32_t id) : _ctx(ctx), _id(id), _cur()
+        {
+            skip();
+        }
+
+        inline const value_type& operator*() const { return _cur; }
+        inline const value_type* operator->() const { return &_cur; }
+
+        inline const_iterator& operator++()
+        {
+            _id++;
+            skip();
+            return *this;
+        }
+
+        inline const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        inline bool operator==(const const_iterator& it) const { return _id == it._id; }
+        inline bool operator!=(const const_iterator& it) const { return _id != it._id; }
+
+    private:
+        void skip()
+        {
+            while (_id < _ctx->size() && !_ctx->is_defined(_id))
+            {
+                _id++;
+            }
+            if (_id < _ctx->size())
+            {
+                _cur.first = _ctx->name(_id);
+                _cur.second = _ctx->value(_id);
+            }
+        }
+
+        const context* _ctx;
+        uint32_t _id;
+        value_type _cur;
+    };
+
+    struct itr_range
     {
-        return (bool)strchr("()!^*/%+-=", ch);
-    } };
+       const_iterator begin;
+       const_iterator end;
+    };
 
-    auto skipSpaces{[](const char*& str)
+    /// @brief команды скомпилированной программы (стековая машина)
+    enum OPCODES : uint8_t
     {
-        while (isspace(*str))
-            str++;
-    }};
+        OP_CONST = 0,   ///< положить в стек константу
+        OP_LOAD,        ///< положить в стек значение слота
+        OP_STORE,       ///< записать вершину стека в слот (без снятия)
+        OP_DROP,        ///< снять вершину стека
+        OP_ADD,         ///< +
+        OP_SUB,         ///< -
+        OP_MUL,         ///< *
+        OP_DIV,         ///< /
+        OP_MOD,         ///< %
+        OP_POW,         ///< ^
+        OP_NEG,         ///< унарный -
+        OP_FACT,        ///< !
+        OP_SAVE,        ///< записать вершину стека во временную ячейку (без снятия)
+        OP_RECALL       ///< положить в стек значение временной ячейки
+    };
 
-    skipSpaces(exp);
-    //Проверка на конец выражения
-    if (exp[0] == 0)
+    //! @brief команда программы
+    struct instr
     {
-        tok_type = NONE;
-        return;
-    }
+        uint8_t op;     ///< код команды ::OPCODES
+        uint32_t arg;   ///< номер слота для OP_LOAD/OP_STORE, ячейки для OP_SAVE/OP_RECALL
+        T value;        ///< значение для OP_CONST
+    };
 
-    //Проверка типа
-    if (isdigit(exp[0]))     //Число
+    /**
+     * @brief Скомпилированное выражение
+     * @note Строка разбирается один раз в compile(), переменные заменены номерами слотов.
+     * Значения слотов передаются в eval() массивом в порядке slot_name()
+     */
+    class program
     {
-        tok_type = NUM;
+    public:
+        program() : table(nullptr), stack_size(0), temps_count(0) {}
+
+        inline bool empty() const { return code.empty(); }
+        inline uint32_t slots_count() const { return (uint32_t)name_pos.size(); }
+        inline const char* slot_name(uint32_t slot) const { return name_buf.c_str() + name_pos[slot]; }
+
+        //! @brief признак присваивания переменной слота в выражении
+        inline bool is_stored(uint32_t slot) const { return stored[slot] != 0; }
+
+        //! @return номер слота переменной или -1, если переменная в выражении не используется
+        int slot(const char* name) const
+        {
+            for (uint32_t i = 0; i < slots_count(); i++)
+            {
+                if (strcmp(slot_name(i), name) == 0)
+                    return (int)i;
+            }
+            return -1;
+        }
+
+        void clear()
+        {
+            code.clear();
+            name_buf.clear();
+            name_pos.clear();
+            stored.clear();
+            ids.clear();
+            table = nullptr;
+            stack_size = 0;
+            temps_count = 0;
+        }
+
+    private:
+        friend class Calculator;
+        template <typename> friend class CalculatorJit;
 
-        int i = 0;
-        //Копирование числа
-        while (isdigit(exp[0]) || exp[0] == '.')
+        std::vector<instr> code;        ///< команды в обратной польской записи
+        std::string name_buf;           ///< имена переменных слотов, разделённые '\0'
+        std::vector<uint32_t> name_pos; ///< начало имени слота в name_buf
+        std::vector<uint8_t> stored;    ///< признаки присваивания слотам
+        std::vector<uint32_t> ids;      ///< номера переменных слотов в таблице table
+        const symbol_table* table;      ///< таблица переменных калькулятора, скомпилировавшего программу
+        uint32_t stack_size;            ///< необходимая глубина стека
+        uint32_t temps_count;           ///< число временных ячеек (общие подвыражения, см. optimize())
+    };
+
+    /**
+     * @brief Контекст вычисления: значения переменных по номерам таблицы имён калькулятора
+     * @note Скомпилированная программа не изменяется при вычислении, поэтому одну программу
+     * можно вычислять одновременно из нескольких потоков, каждый в своём контексте, без блокировок.
+     * На это время калькулятор не должен компилировать новые выражения (таблица имён только читается)
+     */
+    class context
+    {
+    public:
+        explicit context(const symbol_table& table) : _table(&table), _version(0), _was_error(false), _error_code(ERR_UNKNOWN) {}
+
+        //! @brief Вычисление программы на переменных контекста
+        T eval(const program& prog);
+
+        /**
+         * @brief Задать значение переменной
+         * @return false - имя не встречалось в выражениях калькулятора
+         */
+        bool set(const char* name, T value)
+        {
+            int id = _table->find(name);
+            if (id < 0)
+                return false;
+            set((uint32_t)id, value);
+            return true;
+        }
+
+        //! @brief нулевое значение удаляет переменную из списка list_vars()
+        inline void set(uint32_t id, T value)
+        {
+            if (id >= _values.size())
+                resize();
+            if (_values[id] != value)
+                _versions[id] = ++_version;
+            _values[id] = value;
+            _defined[id] = value != 0 ? 1 : 0;
+        }
+
+        //! @return значение переменной (0 для неизвестной)
+        inline T get(const char* name) const
+        {
+            int id = _table->find(name);
+            return id < 0 ? 0 : value((uint32_t)id);
+        }
+
+        inline T value(uint32_t id) const { return id < _values.size() ? _values[id] : 0; }
+        inline bool is_defined(uint32_t id) const { return id < _defined.size() && _defined[id] != 0; }
+        inline const char* name(uint32_t id) const { return _table->name(id); }
+        inline uint32_t size() const { return (uint32_t)_values.size(); }
+
+        //! @brief номер последнего изменения переменной (0 - не изменялась)
+        inline uint64_t version(uint32_t id) const { return id < _versions.size() ? _versions[id] : 0; }
+
+        inline bool was_error() const { return _was_error; }
+        inline const char* error_message() const { return err_msgs[_error_code]; }
+
+        inline const itr_range list_vars() const
+        {
+            return {
+                const_iterator(this, 0),
+                const_iterator(this, size())
+            };
+        }
+
+    private:
+        friend class Calculator;
+
+        void resize()
         {
-            token[i] = *exp++;
-            i++;
+            _values.resize(_table->size(), 0);
+            _defined.resize(_table->size(), 0);
+            _versions.resize(_table->size(), 0);
         }
-        token[i] = 0;
+
+        const symbol_table* _table;     ///< таблица имён калькулятора
+        std::vector<T> _values;         ///< значения по номерам переменных
+        std::vector<uint8_t> _defined;  ///< признаки заданных переменных
+        std::vector<uint64_t> _versions;///< номера последних изменений переменных
+        uint64_t _version;              ///< счётчик изменений переменных
+        std::vector<T> _slots;          ///< значения слотов вычисляемой программы
+        std::vector<T> _stack;          ///< стек и временные ячейки run()
+
+        bool _was_error;
+        ERRORS _error_code;
+    };
+
+private:
+    template <typename> friend class CalculatorJit;   ///< машинный код программ, см. calculator_jit.h
+
+    enum { NONE = 0, NUM, OP, VAR };
+
+    std::string_view token; ///< текущий токен, часть строки выражения
+    char tok_type;
+    const char* exp;
+    uint32_t depth;     ///< глубина стека при компиляции
+    bool _script;       ///< разбор eval_script(): '\n' и ';' - конец выражения
+
+    symbol_table symbols;   ///< имена переменных
+    context vars;           ///< значения переменных калькулятора
+    std::string_view lastVar;
+
+    program _prog;          ///< программа для operator()
+    std::vector<T> _stack;  ///< стек и временные ячейки run()
+    std::vector<T> _batch;  ///< промежуточные блоки для eval_batch()
+    std::vector<const T*> _batch_stack; ///< блоки значений в стеке eval_batch(): столбцы или буферы _batch
+    std::vector<T> _sweep;  ///< столбцы слотов sweep()
+
+    //! @brief разобранное выражение в кэше operator()
+    struct cache_entry
+    {
+        std::string text;
+        program prog;
+        bool pure;          ///< выражение без присваиваний, результат можно хранить
+        bool has_result;
+        T result;
+        uint64_t version;   ///< счётчик изменений переменных при вычислении result
+    };
+
+    std::list<cache_entry> _cache;  ///< от недавно использованных к давно
+    std::unordered_map<std::string_view, typename std::list<cache_entry>::iterator> _cache_index;
+    size_t _cache_capacity;
+    uint64_t _cache_hits;
+    uint64_t _cache_misses;
+
+    //! @brief присваивание, пересчитываемое update()
+    struct formula
+    {
+        program prog;                   ///< пустая - переменная задаётся значением
+        std::vector<uint32_t> deps;     ///< переменные правой части
+    };
+
+    std::vector<formula> _formulas;                 ///< формулы по номерам переменных
+    std::vector<std::vector<uint32_t>> _dependents; ///< переменные, формулы которых читают данную
+    std::vector<uint32_t> _visit;   ///< отметки обхода update()
+    uint32_t _visit_mark;
+    std::vector<uint32_t> _order;   ///< порядок пересчёта update()
+
+    bool _was_error : 1;
+    int  _error_code : 7;
+
+    /// \note функции разбора возвращают false при ошибке, код ошибки записывается в _error_code
+    bool next_token();
+    bool emit(program& prog, uint8_t op, uint32_t arg = 0, T value = 0);
+    uint32_t add_slot(program& prog, std::string_view name);
+
+    inline bool fail(ERRORS ec)
+    {
+        _error_code = ec;
+        return false;
     }
-    else if (isalpha(exp[0]))    //Переменная
+
+    bool eval_exp5(program& prog); // =
+    bool eval_exp4(program& prog); // + -
+    bool eval_exp3(program& prog); // * / %
+    bool eval_exp2(program& prog); // + - Унарные
+    bool eval_exp1(program& prog); // ^ !
+    bool eval_exp0(program& prog); // ( )
+    bool atom(program& prog);
+
+    //! @brief интерпретатор программы, buffer - стек и временные ячейки (размер задаётся по prog)
+    static ERRORS run(const program& prog, T* slots, T& result, std::vector<T>& buffer);
+    ERRORS run_batch(const program& prog, T* const* columns, T* out, size_t n);
+
+    cache_entry* cache_find(const char* exp);
+    bool is_actual(const cache_entry& entry) const;
+
+    void record_formula(const program& prog);
+    void drop_formula(uint32_t id);
+public:
+    Calculator();
+    Calculator(const Calculator& src);
+    Calculator& operator=(const Calculator& src);
+
+    T operator()(const char* exp);
+
+    /**
+     * @brief Разбор выражения в программу для многократного вычисления
+     *
+     * @param[in] exp выражение
+     * @param[out] prog программа
+     * @return false - ошибка разбора (см. error_message())
+     */
+    bool compile(const char* exp, program& prog);
+
+    /**
+     * @brief Оптимизация программы: свёртка константных подвыражений, однократное вычисление
+     * одинаковых подвыражений, замена x^0..x^4 умножениями
+     * @note Программы с присваиваниями внутри выражения (кроме внешнего "x = ...") не изменяются.
+     * Для чисел с плавающей точкой x^3 и x^4 могут отличаться от pow() в последнем знаке
+     * @return false - программа не изменена
+     */
+    static bool optimize(program& prog);
+
+    /**
+     * @brief Вычисление программы с заданными значениями переменных
+     *
+     * @param[in] prog программа
+     * @param[inout] bindings значения слотов (prog.slots_count() эл-в), сюда же записываются присваивания
+     * @return результат выражения
+     */
+    T eval(const program& prog, T* bindings);
+
+    /**
+     * @brief Вычисление программы на переменных калькулятора (аналог operator())
+     * @note номера переменных разрешаются при компиляции, программа другого калькулятора
+     * связывается с переменными по именам
+     */
+    T eval(const program& prog);
+
+    /**
+     * @brief Создать контекст для вычисления программ калькулятора в отдельном потоке
+     * @note контекст получает копию текущих значений переменных
+     */
+    inline context make_context() const { return vars; }
+
+    /**
+     * @brief Пакетное вычисление программы по столбцам
+     * @note Строки обрабатываются блоками по BATCH_BLOCK_SIZE, операции +-*\/ выполняются векторно (см. simd_kernels.h)
+     *
+     * @param[in] prog программа
+     * @param[inout] columns массивы значений слотов: columns[slot][row], prog.slots_count() указателей.
+     * Присваивания записываются в столбец присваиваемого слота
+     * @param[out] out результат (n эл-в)
+     * @param[in] n число строк
+     */
+    void eval_batch(const program& prog, T* const* columns, T* out, size_t n);
+
+    //! @brief значения переменной для sweep(): массив или арифметическая прогрессия
+    struct axis
+    {
+        const char* name;
+        const T* values;    ///< nullptr - значения first + i*step
+        size_t count;
+        T first;
+        T step;
+
+        static axis array(const char* name, const T* values, size_t count)
+        {
+            return { name, values, count, 0, 0 };
+        }
+
+        //! @brief first, first + step, ... до last включительно
+        static axis range(const char* name, T first, T last, T step)
+        {
+            const double n = step == 0 ? 0 : (double)(last - first) / (double)step;
+            return { name, nullptr, n >= 0 ? (size_t)(n + 1e-9) + 1 : 0, first, step };
+        }
+
+        inline T value(size_t i) const { return values ? values[i] : first + T((double)i) * step; }
+    };
+
+    /**
+     * @brief Вычисление программы на сетке значений переменных
+     * @note Сетка: out[i0][i1]...[ik] по всем сочетаниям значений осей, последняя ось меняется быстрее всех.
+     * zip: out[i] вычисляется на i-х значениях всех осей, длина - наименьшая из осей.
+     * Остальные переменные программы берутся из переменных калькулятора, присваивания их не изменяют.
+     * Столбцы заполняются блоками по BATCH_BLOCK_SIZE строк и вычисляются eval_batch()
+     *
+     * @param[in] prog программа
+     * @param[in] axes оси, переменные которых не входят в программу, только повторяют значения
+     * @param[in] n_axes число осей
+     * @param[out] out результаты: произведение длин осей (zip - длина оси) эл-в
+     * @param[in] zip false - сетка, true - параллельный проход осей
+     * @return число вычисленных значений, при ошибке - до блока с ошибкой (см. error_message())
+     */
+    size_t sweep(const program& prog, const axis* axes, size_t n_axes, T* out, bool zip = false);
+
+    //! @brief результат выражения eval_script()
+    struct statement_result
+    {
+        uint32_t index; ///< номер выражения в тексте, считая пустые
+        T value;        ///< 0 при ошибке
+        ERRORS error;   ///< ERR_NONE - без ошибок
+    };
+
+    /**
+     * @brief Вычисление текста из выражений, разделённых '\n' или ';'
+     * @note Выражения разбираются и вычисляются по порядку на переменных калькулятора, присваивания видны
+     * следующим выражениям. Ошибка выражения не прерывает вычисление остальных, пустые выражения пропускаются
+     *
+     * @param[in] text текст, например содержимое файла формул
+     * @return результаты непустых выражений по порядку
+     */
+    std::vector<statement_result> eval_script(const char* text);
+
+    /**
+     * @brief Кэш разобранных выражений operator()
+     * @note Повторно встреченная строка не разбирается. Для выражений без присваиваний хранится и результат,
+     * он пересчитывается после изменения любой входящей в выражение переменной
+     *
+     * @param[in] capacity число хранимых выражений (давно не использованные вытесняются), 0 - кэш выключен
+     */
+    void set_cache_size(size_t capacity);
+
+    inline uint64_t cache_hits() const { return _cache_hits; }
+    inline uint64_t cache_misses() const { return _cache_misses; }
+
+    /**
+     * @brief Задать значение переменной и пересчитать зависящие от неё присваивания
+     * @note Присваивания "x = ..." через operator() и eval() запоминаются вместе с переменными правой части.
+     * Пересчитываются только переменные, прямо или косвенно зависящие от name, в топологическом порядке.
+     * Формула самой переменной name отбрасывается. Переменные циклических зависимостей вычисляются однократно
+     *
+     * @return false - неизвестная переменная или ошибка вычисления формулы (см. error_message())
+     */
+    bool update(const char* name, T value);
+
+    inline bool was_error() { return _was_error; }
+    inline const char* error_message() { return err_msgs[_error_code]; }
+    inline ERRORS error_code() const { return _was_error ? (ERRORS)_error_code : ERR_NONE; }
+
+    //! @brief заданные переменные в порядке их появления
+    inline const itr_range list_vars() const
+    {
+        return vars.list_vars();
+    }
+
+private:
+    /**
+     * @brief Граф выражения для optimize()
+     * @note одинаковые подвыражения представлены одной вершиной, константные сворачиваются при добавлении
+     */
+    class dag
+    {
+    public:
+        //! @brief добавить вершину, вернуть номер новой или уже существующей
+        int32_t add(uint8_t op, uint32_t arg, T value, int32_t a, int32_t b)
+        {
+            if (a >= 0 && _nodes[a].op == OP_CONST && (b < 0 || _nodes[b].op == OP_CONST))
+            {
+                T res;
+                if (fold(op, _nodes[a].value, b < 0 ? 0 : _nodes[b].value, res))
+                    return add(OP_CONST, 0, res, -1, -1);
+            }
+
+            if (op == OP_POW && _nodes[b].op == OP_CONST)  //x^n -> x*x*...
+            {
+                const T n = _nodes[b].value;
+                if (n == 0 && traits::vector)   //для целых x может переполниться
+                    return add(OP_CONST, 0, 1, -1, -1);
+                if (n == 1)
+                    return a;
+                if (n == 2)
+                    return add(OP_MUL, 0, 0, a, a);
+                if (n == 3)
+                    return add(OP_MUL, 0, 0, add(OP_MUL, 0, 0, a, a), a);
+                if (n == 4)
+                {
+                    int32_t sq = add(OP_MUL, 0, 0, a, a);
+                    return add(OP_MUL, 0, 0, sq, sq);
+                }
+            }
+
+            if ((op == OP_ADD || op == OP_MUL) && a > b)
+                std::swap(a, b);
+
+            node nd = { op, arg, op == OP_CONST ? value : 0, a, b };
+            auto it = _index.find(nd);
+            if (it != _index.end())
+                return it->second;
+
+            _nodes.push_back(nd);
+            _index.emplace(nd, (int32_t)_nodes.size() - 1);
+            return (int32_t)_nodes.size() - 1;
+        }
+
+        /**
+         * @brief Генерация кода с вершины root
+         * @note вершина, используемая несколько раз, вычисляется однажды и сохраняется во временную ячейку
+         */
+        void emit(int32_t root, std::vector<instr>& code, uint32_t& stack_size, uint32_t& temps_count)
+        {
+            _uses.assign(_nodes.size(), 0);
+            _temp.assign(_nodes.size(), -1);
+            count_uses(root);
+
+            _code = &code;
+            _depth = 0;
+            _stack_size = 0;
+            _temps = 0;
+            gen(root);
+
+            stack_size = _stack_size;
+            temps_count = _temps;
+        }
+
+    private:
+        struct node
+        {
+            uint8_t op;
+            uint32_t arg;
+            T value;
+            int32_t a, b;   ///< номера вершин-аргументов, -1 - нет
+
+            bool operator<(const node& nd) const
+            {
+                if (op != nd.op) return op < nd.op;
+                if (arg != nd.arg) return arg < nd.arg;
+                if (a != nd.a) return a < nd.a;
+                if (b != nd.b) return b < nd.b;
+                return memcmp(&value, &nd.value, sizeof(T)) < 0;
+            }
+        };
+
+        //! @note операция с ошибкой не сворачивается, ошибка возникнет при вычислении
+        static bool fold(uint8_t op, T a, T b, T& res)
+        {
+            return apply(op, a, b, res);
+        }
+
+        void count_uses(int32_t root)
+        {
+            std::vector<int32_t> stack(1, root);
+            _uses[root] = 1;
+            while (!stack.empty())
+            {
+                const node& nd = _nodes[stack.back()];
+                stack.pop_back();
+                for (int32_t arg : { nd.a, nd.b })
+                {
+                    if (arg >= 0 && _uses[arg]++ == 0)
+                        stack.push_back(arg);
+                }
+            }
+        }
+
+        void gen(int32_t id)
+        {
+            const node& nd = _nodes[id];
+            if (_temp[id] >= 0)
+            {
+                push({ OP_RECALL, (uint32_t)_temp[id], 0 }, 1);
+                return;
+            }
+
+            if (nd.a >= 0)
+                gen(nd.a);
+            if (nd.b >= 0)
+                gen(nd.b);
+
+            const int delta = nd.op == OP_CONST || nd.op == OP_LOAD ? 1 : (nd.b >= 0 ? -1 : 0);
+            push({ nd.op, nd.arg, nd.value }, delta);
+
+            if (_uses[id] > 1 && nd.op != OP_CONST && nd.op != OP_LOAD)
+            {
+                _temp[id] = (int32_t)_temps++;
+                push({ OP_SAVE, (uint32_t)_temp[id], 0 }, 0);
+            }
+        }
+
+        void push(const instr& in, int delta)
+        {
+            _depth += delta;
+            if (_depth > _stack_size)
+                _stack_size = _depth;
+            _code->push_back(in);
+        }
+
+        std::vector<node> _nodes;
+        std::map<node, int32_t> _index;     ///< поиск одинаковых вершин
+        std::vector<uint32_t> _uses;        ///< число ссылок на вершину
+        std::vector<int32_t> _temp;         ///< временная ячейка вершины, -1 - нет
+        std::vector<instr>* _code;
+        uint32_t _depth;
+        uint32_t _stack_size;
+        uint32_t _temps;
+    };
+
+    typedef calc_traits<T> traits;
+
+    //! @brief операция над значениями (b не используется для унарных), false - ошибка
+    static inline bool apply(uint8_t op, T a, T b, T& res)
+    {
+        switch (op)
+        {
+        case OP_ADD: return traits::add(a, b, res);
+        case OP_SUB: return traits::sub(a, b, res);
+        case OP_MUL: return traits::mul(a, b, res);
+        case OP_DIV: return traits::div(a, b, res);
+        case OP_MOD: return traits::mod(a, b, res);
+        case OP_POW: return traits::pow(a, b, res);
+        case OP_NEG: return traits::neg(a, res);
+        case OP_FACT: return traits::fact(a, res);
+        default: return false;
+        }
+    }
+
+    //! @brief код ошибки операции apply()
+    static inline ERRORS op_error(uint8_t op, T a, T b)
+    {
+        if (((op == OP_DIV || op == OP_MOD) && b == 0) || (op == OP_POW && a == 0))
+            return ERR_DIV;
+        return ERR_OVER;
+    }
+
+    //! @brief поэлементная операция над блоком eval_batch()
+    static ERRORS apply_block(uint8_t op, const T* a, const T* b, T* res, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const T x = a[i], y = b ? b[i] : 0;
+            if (!apply(op, x, y, res[i]))
+                return op_error(op, x, y);
+        }
+        return ERR_NONE;
+    }
+};
+//=============================================================================================
+#include <cstdlib>
+#include <cmath>
+
+template <typename T>
+Calculator<T>::Calculator() : vars(symbols)
+{
+    tok_type = NONE;
+    exp = nullptr;
+    depth = 0;
+    _script = false;
+    _was_error = false;
+    _error_code = ERR_UNKNOWN;
+    _cache_capacity = 0;
+    _cache_hits = 0;
+    _cache_misses = 0;
+    _visit_mark = 0;
+}
+
+template <typename T>
+Calculator<T>::Calculator(const Calculator& src) : Calculator()
+{
+    *this = src;
+}
+
+template <typename T>
+Calculator<T>& Calculator<T>::operator=(const Calculator& src)
+{
+    if (this != &src)
+    {
+        symbols = src.symbols;
+        vars = src.vars;
+        vars._table = &symbols;
+        _was_error = src._was_error;
+        _error_code = src._error_code;
+
+        //программы кэша ссылаются на таблицу имён src
+        _cache.clear();
+        _cache_index.clear();
+        _cache_capacity = src._cache_capacity;
+        _cache_hits = 0;
+        _cache_misses = 0;
+
+        _formulas = src._formulas;
+        for (formula& f : _formulas)
+            f.prog.table = &symbols;
+        _dependents = src._dependents;
+    }
+    return *this;
+}
+
+template <typename T>
+bool Calculator<T>::next_token()
+{
+    using namespace calc_token;
+
+    const char_table& cls = _script ? script_classes : classes;
+    const char* p = exp;
+    while (cls[*p] == CH_SPACE)
+        p++;
+
+    const char* start = p;
+    switch (cls[*p])
+    {
+    case CH_END:    //Конец выражения
+        exp = p;
+        tok_type = NONE;
+        return true;
+    case CH_DIGIT:  //Число
+        tok_type = NUM;
+        while (cls[*p] == CH_DIGIT || *p == '.')
+            p++;
+        break;
+    case CH_ALPHA:  //Переменная
+        tok_type = VAR;
+        while (cls[*p] == CH_ALPHA)
+            p++;
+        break;
+    case CH_OP:     //Оператор
+        tok_type = OP;
+        p++;
+        break;
+    default:
+        exp = p;
+        return fail(ERR_UNKNOWN);
+    }
+
+    token = std::string_view(start, (size_t)(p - start));
+    exp = p;
+    return true;
+}
+
+template <typename T>
+T Calculator<T>::operator()(const char* exp)
+{
+    if (!_cache_capacity)
+    {
+        if (!compile(exp, _prog))
+        {
+            return 0;
+        }
+        return eval(_prog);
+    }
+
+    cache_entry* entry = cache_find(exp);
+    if (!entry)
+        return 0;
+
+    if (entry->has_result && is_actual(*entry))
+    {
+        _was_error = false;
+        return entry->result;
+    }
+
+    T result = eval(entry->prog);
+    if (entry->pure && !_was_error)
+    {
+        entry->has_result = true;
+        entry->result = result;
+        entry->version = vars._version;
+    }
+    return result;
+}
+
+template <typename T>
+std::vector<typename Calculator<T>::statement_result> Calculator<T>::eval_script(const char* text)
+{
+    using namespace calc_token;
+
+    size_t count = 1;   //результаты - одним выделением памяти
+    for (const char* p = text; *p; p++)
+        count += script_classes[*p] == CH_END;
+    std::vector<statement_result> results;
+    results.reserve(count);
+
+    _script = true;
+    const char* p = text;
+    for (uint32_t index = 0; ; index++)
+    {
+        while (script_classes[*p] == CH_SPACE)
+            p++;
+        if (script_classes[*p] != CH_END)
+        {
+            T value = compile(p, _prog) ? eval(_prog) : 0;
+            results.push_back({ index, value, error_code() });
+
+            p = exp;    //место остановки разбора, лишние токены выражения пропускаются
+            while (script_classes[*p] != CH_END)
+                p++;
+        }
+        if (*p == 0)
+            break;
+        p++;
+    }
+    _script = false;
+    return results;
+}
+
+template <typename T>
+void Calculator<T>::set_cache_size(size_t capacity)
+{
+    _cache_capacity = capacity;
+    while (_cache.size() > capacity)
+    {
+        _cache_index.erase(_cache.back().text);
+        _cache.pop_back();
+    }
+}
+
+/**
+ * @brief Поиск выражения в кэше, при отсутствии - разбор и добавление
+ * @return nullptr - ошибка разбора
+ */
+template <typename T>
+typename Calculator<T>::cache_entry* Calculator<T>::cache_find(const char* exp)
+{
+    auto it = _cache_index.find(std::string_view(exp));
+    if (it != _cache_index.end())
+    {
+        _cache_hits++;
+        _cache.splice(_cache.begin(), _cache, it->second);
+        return &_cache.front();
+    }
+
+    _cache_misses++;
+    program prog;
+    if (!compile(exp, prog))
+        return nullptr;
+
+    if (_cache.size() >= _cache_capacity)
+    {
+        _cache_index.erase(_cache.back().text);
+        _cache.pop_back();
+    }
+
+    bool pure = true;
+    for (uint32_t i = 0; i < prog.slots_count(); i++)
+    {
+        if (prog.is_stored(i))
+            pure = false;
+    }
+
+    _cache.push_front({ exp, std::move(prog), pure, false, 0, 0 });
+    _cache_index.emplace(_cache.front().text, _cache.begin());
+    return &_cache.front();
+}
+
+//! @brief сохранённый результат не устарел: переменные выражения не менялись после его вычисления
+template <typename T>
+bool Calculator<T>::is_actual(const cache_entry& entry) const
+{
+    for (uint32_t id : entry.prog.ids)
+    {
+        if (vars.version(id) > entry.version)
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool Calculator<T>::compile(const char* exp, program& prog)
+{
+    prog.clear();
+    prog.table = &symbols;
+    this->exp = exp;
+    this->depth = 0;
+    this->lastVar = std::string_view();
+    this->_was_error = !eval_exp5(prog);
+
+    if (_was_error)
+    {
+        prog.clear();
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+T Calculator<T>::eval(const program& prog, T* bindings)
+{
+    if (prog.empty())
+    {
+        _was_error = true;
+        _error_code = ERR_END;
+        return 0;
+    }
+
+    T result = 0;
+    ERRORS ec = run(prog, bindings, result, _stack);
+    _was_error = ec != ERR_NONE;
+    if (_was_error)
+    {
+        _error_code = ec;
+        result = 0;
+    }
+    return result;
+}
+
+template <typename T>
+T Calculator<T>::eval(const program& prog)
+{
+    if (prog.table != &symbols)
+    {
+        //программа другого калькулятора: имена добавляются в свою таблицу
+        for (uint32_t i = 0; i < prog.slots_count(); i++)
+        {
+            symbols.intern(prog.slot_name(i), strlen(prog.slot_name(i)));
+        }
+    }
+
+    T result = vars.eval(prog);
+    _was_error = vars._was_error;
+    _error_code = vars._error_code;
+    if (!_was_error && prog.table == &symbols)
+        record_formula(prog);
+    return result;
+}
+
+/**
+ * @brief Запомнить присваивание для update()
+ * @note запоминаются выражения вида "x = f(...)" без x в правой части,
+ * у переменных остальных присваиваний формула отбрасывается
+ */
+template <typename T>
+void Calculator<T>::record_formula(const program& prog)
+{
+    const instr& last = prog.code.back();
+    uint32_t stores = 0;
+    for (uint32_t i = 0; i < prog.slots_count(); i++)
+        stores += prog.is_stored(i);
+    if (!stores)
+        return;
+
+    bool track = stores == 1 && last.op == OP_STORE && prog.slots_count() > 1;
+    for (uint32_t i = 0; i < prog.slots_count() && track; i++)
+        track = !prog.is_stored(i) || i == last.arg;
+    for (size_t i = 0; i + 1 < prog.code.size() && track; i++)
+    {
+        //x в правой части; левая часть "x =" - OP_LOAD x, OP_DROP
+        track = !(prog.code[i].op == OP_LOAD && prog.code[i].arg == last.arg && prog.code[i + 1].op != OP_DROP);
+    }
+    if (!track)
+    {
+        for (uint32_t i = 0; i < prog.slots_count(); i++)
+        {
+            if (prog.is_stored(i))
+                drop_formula(prog.ids[i]);
+        }
+        return;
+    }
+
+    const uint32_t target = prog.ids[last.arg];
+    if (target < _formulas.size())
+    {
+        //повторное присваивание той же формулой
+        const std::vector<instr>& code = _formulas[target].prog.code;
+        bool same = code.size() == prog.code.size();
+        for (size_t i = 0; i < code.size() && same; i++)
+        {
+            same = code[i].op == prog.code[i].op && code[i].arg == prog.code[i].arg &&
+                memcmp(&code[i].value, &prog.code[i].value, sizeof(T)) == 0;
+        }
+        if (same && _formulas[target].prog.ids == prog.ids)
+            return;
+    }
+
+    drop_formula(target);
+    if (_formulas.size() < symbols.size())
+    {
+        _formulas.resize(symbols.size());
+        _dependents.resize(symbols.size());
+    }
+
+    formula& f = _formulas[target];
+    f.prog = prog;
+    for (uint32_t i = 0; i < prog.slots_count(); i++)
+    {
+        if (i != last.arg)
+        {
+            f.deps.push_back(prog.ids[i]);
+            _dependents[prog.ids[i]].push_back(target);
+        }
+    }
+}
+
+template <typename T>
+void Calculator<T>::drop_formula(uint32_t id)
+{
+    if (id >= _formulas.size() || _formulas[id].prog.empty())
+        return;
+
+    for (uint32_t dep : _formulas[id].deps)
+    {
+        std::vector<uint32_t>& list = _dependents[dep];
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            if (list[i] == id)
+            {
+                list[i] = list.back();
+                list.pop_back();
+                break;
+            }
+        }
+    }
+    _formulas[id].prog.clear();
+    _formulas[id].deps.clear();
+}
+
+template <typename T>
+bool Calculator<T>::update(const char* name, T value)
+{
+    int found = symbols.find(name);
+    if (found < 0)
+        return false;
+
+    const uint32_t id = (uint32_t)found;
+    drop_formula(id);
+    vars.set(id, value);
+    _was_error = false;
+    if (id >= _dependents.size())
+        return true;
+
+    //обратный порядок завершения обхода в глубину - топологический
+    if (_visit.size() < _dependents.size())
+        _visit.resize(_dependents.size(), 0);
+    if (++_visit_mark == 0)
+    {
+        std::fill(_visit.begin(), _visit.end(), 0);
+        _visit_mark = 1;
+    }
+
+    _order.clear();
+    std::vector<std::pair<uint32_t, uint32_t>> stack;  //переменная, номер следующей зависимой
+    stack.push_back({ id, 0 });
+    _visit[id] = _visit_mark;
+    while (!stack.empty())
+    {
+        const uint32_t var = stack.back().first;
+        const uint32_t next = stack.back().second++;
+        if (next < _dependents[var].size())
+        {
+            const uint32_t dep = _dependents[var][next];
+            if (_visit[dep] != _visit_mark)
+            {
+                _visit[dep] = _visit_mark;
+                stack.push_back({ dep, 0 });
+            }
+        }
+        else
+        {
+            _order.push_back(var);
+            stack.pop_back();
+        }
+    }
+
+    _order.pop_back();  //сама переменная id
+    for (auto it = _order.rbegin(); it != _order.rend(); ++it)
+    {
+        vars.eval(_formulas[*it].prog);
+        if (vars._was_error)
+        {
+            _was_error = true;
+            _error_code = vars._error_code;
+        }
+    }
+    return !_was_error;
+}
+
+template <typename T>
+T Calculator<T>::context::eval(const program& prog)
+{
+    if (prog.empty())
+    {
+        _was_error = true;
+        _error_code = ERR_END;
+        return 0;
+    }
+
+    if (_values.size() < _table->size())
+        resize();
+
+    const bool own = prog.table == _table;
+    const uint32_t n = prog.slots_count();
+    _slots.resize(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int id = own ? (int)prog.ids[i] : _table->find(prog.slot_name(i));
+        _slots[i] = id < 0 ? 0 : _values[id];
+    }
+
+    T result = 0;
+    ERRORS ec = run(prog, _slots.data(), result, _stack);
+    _was_error = ec != ERR_NONE;
+    if (_was_error)
+    {
+        _error_code = ec;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (prog.is_stored(i))
+        {
+            int id = own ? (int)prog.ids[i] : _table->find(prog.slot_name(i));
+            if (id >= 0)
+                set((uint32_t)id, _slots[i]);
+        }
+    }
+    return result;
+}
+
+template <typename T>
+uint32_t Calculator<T>::add_slot(program& prog, std::string_view name)
+{
+    const uint32_t id = symbols.intern(name.data(), name.size());
+    for (uint32_t i = 0; i < prog.ids.size(); i++)
+    {
+        if (prog.ids[i] == id)
+            return i;
+    }
+
+    prog.name_pos.push_back((uint32_t)prog.name_buf.size());
+    prog.name_buf.append(name.data(), name.size());
+    prog.name_buf.push_back(0);
+    prog.stored.push_back(0);
+    prog.ids.push_back(id);
+    return prog.slots_count() - 1;
+}
+
+template <typename T>
+typename Calculator<T>::ERRORS Calculator<T>::run(const program& prog, T* slots, T& result, std::vector<T>& buffer)
+{
+    buffer.resize(prog.stack_size + prog.temps_count);
+    T* stack = buffer.data();
+    T* temps = stack + prog.stack_size;
+    uint32_t sp = 0;    //число эл-в в стеке
+
+    for (const instr& in : prog.code)
+    {
+        switch (in.op)
+        {
+        case OP_CONST:
+            stack[sp++] = in.value;
+            break;
+        case OP_LOAD:
+            stack[sp++] = slots[in.arg];
+            break;
+        case OP_STORE:
+            slots[in.arg] = stack[sp - 1];
+            break;
+        case OP_DROP:
+            sp--;
+            break;
+        case OP_ADD:
+            sp--;
+            if (!traits::add(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return ERR_OVER;
+            break;
+        case OP_SUB:
+            sp--;
+            if (!traits::sub(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return ERR_OVER;
+            break;
+        case OP_MUL:
+            sp--;
+            if (!traits::mul(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return ERR_OVER;
+            break;
+        case OP_DIV:
+            sp--;
+            if (!traits::div(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return op_error(OP_DIV, stack[sp - 1], stack[sp]);
+            break;
+        case OP_MOD:
+            sp--;
+            if (!traits::mod(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return op_error(OP_MOD, stack[sp - 1], stack[sp]);
+            break;
+        case OP_POW:
+            sp--;
+            if (!traits::pow(stack[sp - 1], stack[sp], stack[sp - 1]))
+                return op_error(OP_POW, stack[sp - 1], stack[sp]);
+            break;
+        case OP_NEG:
+            if (!traits::neg(stack[sp - 1], stack[sp - 1]))
+                return ERR_OVER;
+            break;
+        case OP_FACT:
+            if (!traits::fact(stack[sp - 1], stack[sp - 1]))
+                return ERR_OVER;
+            break;
+        case OP_SAVE:
+            temps[in.arg] = stack[sp - 1];
+            break;
+        case OP_RECALL:
+            stack[sp++] = temps[in.arg];
+            break;
+        }
+    }
+    result = stack[sp - 1];
+    return ERR_NONE;
+}
+
+template <typename T>
+void Calculator<T>::eval_batch(const program& prog, T* const* columns, T* out, size_t n)
+{
+    if (prog.empty())
+    {
+        _was_error = true;
+        _error_code = ERR_END;
+        return;
+    }
+
+    ERRORS ec = run_batch(prog, columns, out, n);
+    _was_error = ec != ERR_NONE;
+    if (_was_error)
+    {
+        _error_code = ec;
+    }
+}
+
+template <typename T>
+size_t Calculator<T>::sweep(const program& prog, const axis* axes, size_t n_axes, T* out, bool zip)
+{
+    _was_error = false;
+    if (prog.empty())
+    {
+        _was_error = true;
+        _error_code = ERR_END;
+        return 0;
+    }
+
+    //шаг оси в плоском индексе: число значений сетки на одно значение оси
+    std::vector<size_t> strides(n_axes, 1);
+    size_t total = n_axes ? axes[0].count : 1;
+    for (size_t k = 1; k < n_axes; k++)
+        total = zip ? std::min(total, axes[k].count) : total * axes[k].count;
+    for (size_t k = n_axes; !zip && k-- > 1; )
+        strides[k - 1] = strides[k] * axes[k].count;
+
+    const uint32_t n = prog.slots_count();
+    std::vector<int> slot_axis(n, -1);
+    for (size_t k = 0; k < n_axes; k++)
+    {
+        int slot = prog.slot(axes[k].name);
+        if (slot >= 0)
+            slot_axis[slot] = (int)k;
+    }
+
+    _sweep.resize((size_t)n * BATCH_BLOCK_SIZE);
+    std::vector<T*> columns(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        columns[i] = _sweep.data() + (size_t)i * BATCH_BLOCK_SIZE;
+        if (slot_axis[i] < 0)
+            std::fill(columns[i], columns[i] + BATCH_BLOCK_SIZE, vars.get(prog.slot_name(i)));
+    }
+
+    for (size_t row = 0; row < total; row += BATCH_BLOCK_SIZE)
+    {
+        const size_t m = std::min<size_t>(total - row, BATCH_BLOCK_SIZE);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (slot_axis[i] < 0)
+            {
+                if (prog.is_stored(i))  //столбец перезаписан присваиванием предыдущего блока
+                    std::fill(columns[i], columns[i] + m, vars.get(prog.slot_name(i)));
+                continue;
+            }
+
+            //участки одинаковых значений внешних осей, непрерывные отрезки последней оси
+            const axis& ax = axes[slot_axis[i]];
+            const size_t stride = strides[slot_axis[i]];
+            T* col = columns[i];
+            for (size_t j = 0; j < m; )
+            {
+                const size_t pos = (row + j) / stride % (zip ? total : ax.count);
+                size_t len;
+                if (stride == 1)
+                {
+                    len = std::min((zip ? total : ax.count) - pos, m - j);
+                    if (ax.values)
+                        std::copy(ax.values + pos, ax.values + pos + len, col + j);
+                    else
+                    {
+                        for (size_t r = 0; r < len; r++)
+                            col[j + r] = ax.first + T((double)(pos + r)) * ax.step;
+                    }
+                }
+                else
+                {
+                    len = std::min(stride - (row + j) % stride, m - j);
+                    std::fill(col + j, col + j + len, ax.value(pos));
+                }
+                j += len;
+            }
+        }
+
+        ERRORS ec = run_batch(prog, columns.data(), out + row, m);
+        if (ec != ERR_NONE)
+        {
+            _was_error = true;
+            _error_code = ec;
+            return row;
+        }
+    }
+    return total;
+}
+
+template <typename T>
+typename Calculator<T>::ERRORS Calculator<T>::run_batch(const program& prog, T* const* columns, T* out, size_t n)
+{
+    using namespace math;
+
+    _batch.resize((prog.stack_size + prog.temps_count) * BATCH_BLOCK_SIZE);
+    T* temps = _batch.data() + prog.stack_size * BATCH_BLOCK_SIZE;
+
+    _batch_stack.resize(prog.stack_size);
+    const T** stack = _batch_stack.data();
+
+    for (size_t row = 0; row < n; row += BATCH_BLOCK_SIZE)
+    {
+        const size_t m = (n - row < BATCH_BLOCK_SIZE) ? n - row : BATCH_BLOCK_SIZE;
+        uint32_t sp = 0;
+
+        for (const instr& in : prog.code)
+        {
+            //буфер для результата на текущей вершине стека
+            T* dst = _batch.data() + (in.op == OP_CONST || in.op == OP_LOAD || in.op == OP_RECALL ? sp : sp - 1) * BATCH_BLOCK_SIZE;
+
+            switch (in.op)
+            {
+            case OP_CONST:
+                simd::fill(dst, in.value, m);
+                stack[sp++] = dst;
+                break;
+            case OP_LOAD:
+                if (prog.is_stored(in.arg))
+                {
+                    //столбец может быть перезаписан до использования значения
+                    memcpy(dst, columns[in.arg] + row, m * sizeof(T));
+                    stack[sp++] = dst;
+                }
+                else
+                    stack[sp++] = columns[in.arg] + row;
+                break;
+            case OP_STORE:
+                memcpy(columns[in.arg] + row, stack[sp - 1], m * sizeof(T));
+                break;
+            case OP_DROP:
+                sp--;
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+            case OP_POW:
+            {
+                dst -= BATCH_BLOCK_SIZE;
+                sp--;
+                const T* a = stack[sp - 1];
+                const T* b = stack[sp];
+                ERRORS ec = ERR_NONE;
+                if constexpr (traits::vector)
+                {
+                    switch (in.op)
+                    {
+                    case OP_ADD: simd::add(a, b, dst, m); break;
+                    case OP_SUB: simd::sub(a, b, dst, m); break;
+                    case OP_MUL: simd::mul(a, b, dst, m); break;
+                    case OP_DIV: simd::div(a, b, dst, m); break;
+                    case OP_POW: simd::pow(a, b, dst, m); break;
+                    default: ec = apply_block(in.op, a, b, dst, m); break;
+                    }
+                }
+                else
+                    ec = apply_block(in.op, a, b, dst, m);
+                if (ec != ERR_NONE)
+                    return ec;
+                stack[sp - 1] = dst;
+                break;
+            }
+            case OP_NEG:
+            case OP_FACT:
+            {
+                ERRORS ec = ERR_NONE;
+                if constexpr (traits::vector)
+                {
+                    if (in.op == OP_NEG)
+                        simd::neg(stack[sp - 1], dst, m);
+                    else
+                        ec = apply_block(in.op, stack[sp - 1], nullptr, dst, m);
+                }
+                else
+                    ec = apply_block(in.op, stack[sp - 1], nullptr, dst, m);
+                if (ec != ERR_NONE)
+                    return ec;
+                stack[sp - 1] = dst;
+                break;
+            }
+            case OP_SAVE:
+                memcpy(temps + in.arg * BATCH_BLOCK_SIZE, stack[sp - 1], m * sizeof(T));
+                break;
+            case OP_RECALL:
+                stack[sp++] = temps + in.arg * BATCH_BLOCK_SIZE;
+                break;
+            }
+        }
+        memcpy(out + row, stack[sp - 1], m * sizeof(T));
+    }
+    return ERR_NONE;
+}
+
+template <typename T>
+bool Calculator<T>::optimize(program& prog)
+{
+    if (prog.empty() || prog.temps_count)
+        return false;
+
+    //присваивание внутри выражения меняет значение слота по ходу вычисления
+    for (size_t i = 0; i + 1 < prog.code.size(); i++)
     {
-        tok_type = VAR;
+        if (prog.code[i].op == OP_STORE)
+            return false;
+    }
 
-        int i = 0;
-        //Копирование переменной
-        while (isalpha(exp[0]))
+    dag graph;
+    std::vector<int32_t> stack;
+    for (const instr& in : prog.code)
+    {
+        switch (in.op)
+        {
+        case OP_CONST:
+        case OP_LOAD:
+            stack.push_back(graph.add(in.op, in.arg, in.value, -1, -1));
+            break;
+        case OP_STORE:  //последняя команда, переносится без изменений
+            break;
+        case OP_DROP:
+            stack.pop_back();
+            break;
+        case OP_NEG:
+        case OP_FACT:
+            stack.back() = graph.add(in.op, 0, 0, stack.back(), -1);
+            break;
+        default:
         {
-            token[i] = *exp++;
-            i++;
+            int32_t b = stack.back();
+            stack.pop_back();
+            stack.back() = graph.add(in.op, 0, 0, stack.back(), b);
+            break;
+        }
         }
-        token[i] = 0;
-    }
-    else if ( isoperator(exp[0])) //Оператор
-    {
-        *token = *exp++;
-        tok_type = OP;
     }
-    else
-        throw ERR_UNKNOWN;
+
+    std::vector<instr> code;
+    uint32_t stack_size, temps_count;
+    graph.emit(stack.back(), code, stack_size, temps_count);
+
+    if (prog.code.back().op == OP_STORE)
+        code.push_back(prog.code.back());
+
+    prog.code.swap(code);
+    prog.stack_size = stack_size;
+    prog.temps_count = temps_count;
+    return true;
 }
 
 template <typename T>
-T Calculator<T>::operator()(const char* exp)
+bool Calculator<T>::emit(program& prog, uint8_t op, uint32_t arg, T value)
 {
-    this->exp = exp;
-    T result = 0;
-    this->_was_error = false;
-
-    try
-    {
-        eval_exp5(result);
-    }
-    catch (ERRORS ec)
+    switch (op)
     {
-        _was_error = true;
-        _error_code = ec;
-        result = 0;
+    case OP_CONST:
+    case OP_LOAD:
+    case OP_RECALL:
+        if (++depth > prog.stack_size)
+            prog.stack_size = depth;
+        break;
+    case OP_STORE:
+    case OP_NEG:
+    case OP_FACT:
+    case OP_SAVE:
+        break;
+    default:    //OP_DROP и бинарные операции
+        depth--;
+        break;
     }
-    return result;
+    prog.code.push_back({ op, arg, value });
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp5(T& result)    // =
+bool Calculator<T>::eval_exp5(program& prog)    // =
 {
-    next_token();
-    eval_exp4(result);
+    if (!next_token() || !eval_exp4(prog))
+        return false;
 
     if (tok_type == OP &&
         token[0] == '=')
     {
-        char* tmp = new char[strlen(lastVar) + 1];
-        strcpy(tmp, lastVar);
-        next_token();
-        eval_exp4(result);
-        if (result)
-            vars[tmp] = result;
-        else
-            vars.erase(tmp);
+        if (lastVar.empty())    //слева нет переменной
+            return fail(ERR_OP);
+
+        uint32_t slot = add_slot(prog, lastVar);
+        if (!emit(prog, OP_DROP) || !next_token() || !eval_exp4(prog) ||
+            !emit(prog, OP_STORE, slot))
+            return false;
+        prog.stored[slot] = true;
     }
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp4(T& result)    // + -
+bool Calculator<T>::eval_exp4(program& prog)    // + -
 {
-    eval_exp3(result);
+    if (!eval_exp3(prog))
+        return false;
 
     char op = token[0];
     while (tok_type == OP &&
         (op == '+' ||
             op == '-'))
     {
-        next_token();
-        T tmp = 0;
-        eval_exp3(tmp);
+        if (!next_token() || !eval_exp3(prog))
+            return false;
         switch (op)
         {
         case '+':
-            result += tmp;
+            emit(prog, OP_ADD);
             break;
         case '-':
-            result -= tmp;
+            emit(prog, OP_SUB);
             break;
         }
         op = token[0];
     }
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp3(T& result)    // * / %
+bool Calculator<T>::eval_exp3(program& prog)    // * / %
 {
-    eval_exp2(result);
+    if (!eval_exp2(prog))
+        return false;
 
     char op = token[0];
     while (tok_type == OP &&
@@ -251,27 +2034,27 @@ void Calculator<T>::eval_exp3(T& result)    // * / %
             op == '/' ||
             op == '%'))
     {
-        next_token();
-        T tmp = 0;
-        eval_exp2(tmp);
+        if (!next_token() || !eval_exp2(prog))
+            return false;
         switch (op)
         {
         case '*':
-            result *= tmp;
+            emit(prog, OP_MUL);
             break;
         case '/':
-            result /= tmp;
+            emit(prog, OP_DIV);
             break;
         case '%':
-            result = (T)((int64_t)floor(result) % (int64_t)floor(tmp));
+            emit(prog, OP_MOD);
             break;
         }
         op = token[0];
     }
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp2(T& result)    // + - Унарные
+bool Calculator<T>::eval_exp2(program& prog)    // + - Унарные
 {
     char op = '+';
 
@@ -280,25 +2063,29 @@ void Calculator<T>::eval_exp2(T& result)    // + - Унарные
             || token[0] == '-'))    //Есть подходящий оператор
     {
         op = token[0];
-        next_token();
+        if (!next_token())
+            return false;
     }
 
-    eval_exp1(result);
+    if (!eval_exp1(prog))
+        return false;
 
     switch (op)
     {
     case '+':
         break;
     case '-':
-        result = -result;
+        emit(prog, OP_NEG);
         break;
     }
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp1(T& result)    // ^ !
+bool Calculator<T>::eval_exp1(program& prog)    // ^ !
 {
-    eval_exp0(result);
+    if (!eval_exp0(prog))
+        return false;
 
     char op = token[0];
     while (tok_type == OP &&
@@ -306,72 +2093,747 @@ void Calculator<T>::eval_exp1(T& result)    // ^ !
             || op == '!')
         )
     {
-        next_token();
-        T tmp = 0;
+        if (!next_token())
+            return false;
         switch (op)
         {
         case '^':
-            eval_exp1(tmp);
-            result = (T)pow(result, tmp);
+            if (!eval_exp1(prog))
+                return false;
+            emit(prog, OP_POW);
             break;
         case '!':
-            try
-            {
-                result = (T)fact((uint64_t)abs(floor(result)));    // = |_result_|!
-            }
-            catch (...)
-            {
-                throw ERR_OVER;
-            }
+            emit(prog, OP_FACT);    // = |_result_|!
             break;
         }
         op = token[0];
     }
+    return true;
 }
 
 template <typename T>
-void Calculator<T>::eval_exp0(T& result)    // ( )
+bool Calculator<T>::eval_exp0(program& prog)    // ( )
 {
-    if (tok_type == OP && *token == '(')
+    if (tok_type == OP && token[0] == '(')
     {
-        eval_exp5(result);
+        if (!eval_exp5(prog))
+            return false;
         if (!(tok_type == OP &&
             token[0] == ')'))
-            throw ERR_BAL;
+            return fail(ERR_BAL);
         else
-            next_token();
+            return next_token();
     }
     else
-        atom(result);
+        return atom(prog);
 }
 
 template <typename T>
-void Calculator<T>::atom(T& result)
+bool Calculator<T>::atom(program& prog)
 {
     if (tok_type == OP)
-        throw ERR_OP;
+        return fail(ERR_OP);
     if (tok_type == NONE)
-        throw ERR_END;
+        return fail(ERR_END);
 
     if (tok_type == VAR)
     {
-        strcpy(lastVar, token);
+        lastVar = token;
+        if (!emit(prog, OP_LOAD, add_slot(prog, token)))
+            return false;
+    }
+    else
+    {
+        T value = 0;
+        if (!calc_token::parse_number(token.data(), token.data() + token.size(), value))
+            return fail(ERR_OVER);
+        if (!emit(prog, OP_CONST, 0, value))
+            return false;
+    }
+    return next_token();
+}
+
+//! @brief значение переменной для calc_eval()
+template <typename T>
+struct calc_binding
+{
+    const char* name;
+    T value;
+};
+
+#define MAX_CONSTEXPR_VARS 16 ///< число переменных, присваиваемых в выражении calc_eval()
+
+namespace calc_constexpr
+{
+    /// \note функции ошибок не constexpr: ошибка разбора в константном выражении - ошибка компиляции с именем функции
+    inline bool broken_balance_brackets() { return false; }
+    inline bool unexpected_end_of_expression() { return false; }
+    inline bool unexpected_operator() { return false; }
+    inline bool unknown_symbol() { return false; }
+    inline bool too_many_variables() { return false; }
+    inline bool overflow() { return false; }
+    inline bool division_by_zero() { return false; }
+
+    constexpr double INF = std::numeric_limits<double>::infinity();
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+    constexpr double DOUBLE_MAX = std::numeric_limits<double>::max();
+
+    constexpr bool isnan(double x) { return x != x; }
+    constexpr bool isinf(double x) { return x == INF || x == -INF; }
+    constexpr double fabs(double x) { return x < 0 ? -x : x; }
+
+    //! @note без __builtin_signbit знак нуля не различается
+    constexpr bool signbit(double x)
+    {
+#if defined(__GNUC__)
+        return __builtin_signbit(x);
+#else
+        return x < 0;
+#endif
+    }
+
+    constexpr double floor(double x)
+    {
+        if (!(x > -9.2e18 && x < 9.2e18) || x == 0)   //NaN, inf, уже целое или -0
+            return x;
+        double i = (double)(int64_t)x;
+        return i > x ? i - 1 : i;
+    }
+
+    //! @brief 2^e, e <= 1023
+    constexpr double pow2(int e)
+    {
+        double r = 1;
+        for (; e > 0; e--)
+            r *= 2;
+        for (; e < 0; e++)
+            r /= 2;
+        return r;
+    }
+
+    //! @brief точный остаток, как fmod(): вычитания y*2^k, каждое без округления
+    constexpr double fmod(double x, double y)
+    {
+        if (isnan(x) || isnan(y) || isinf(x) || y == 0)
+            return NaN;
+        double ax = fabs(x), ay = fabs(y);
+        if (ax < ay)    //в т.ч. y = inf
+            return x;
+        while (ax >= ay)
+        {
+            double t = ay;
+            while (t <= DOUBLE_MAX / 2 && t * 2 <= ax)
+                t *= 2;
+            ax -= t;
+        }
+        return signbit(x) ? -ax : ax;
+    }
+
+    //! @brief |floor(a)|!, младшие 64 бита: от 66! (а также для inf и NaN) они равны 0
+    constexpr uint64_t fact(double a)
+    {
+        const double n = fabs(floor(a));
+        uint64_t result = n < 66 ? 1 : 0;
+        for (uint64_t i = 2; i <= n && result; i++)
+            result *= i;
+        return result;
+    }
+
+    /**
+     * @brief Число двойной точности hi + lo (|lo| <= ulp(hi)/2) для pow() и number()
+     * @note около 106 бит мантиссы: округленный до double результат почти всегда совпадает с правильно округленным
+     */
+    struct dd
+    {
+        double hi = 0;
+        double lo = 0;
+    };
+
+    constexpr dd quick_two_sum(double a, double b)
+    {
+        const double s = a + b;
+        return { s, b - (s - a) };
+    }
+
+    constexpr dd two_sum(double a, double b)
+    {
+        const double s = a + b, v = s - a;
+        return { s, (a - (s - v)) + (b - v) };
+    }
+
+    //! @brief a = hi + lo, по 26 значащих бит (разбиение Деккера)
+    constexpr dd split(double a)
+    {
+        if (a > 6.69692879491417e+299 || a < -6.69692879491417e+299)    //2^996
+        {
+            const dd s = split(a * 3.7252902984619140625e-09);  //2^-28
+            return { s.hi * 268435456.0, s.lo * 268435456.0 };
+        }
+        const double t = 134217729.0 * a;   //2^27 + 1
+        const double hi = t - (t - a);
+        return { hi, a - hi };
+    }
+
+    constexpr dd two_prod(double a, double b)
+    {
+        const double p = a * b;
+        const dd as = split(a), bs = split(b);
+        return { p, ((as.hi * bs.hi - p) + as.hi * bs.lo + as.lo * bs.hi) + as.lo * bs.lo };
+    }
+
+    constexpr dd add(dd a, dd b)
+    {
+        dd s = two_sum(a.hi, b.hi);
+        const dd t = two_sum(a.lo, b.lo);
+        s = quick_two_sum(s.hi, s.lo + t.hi);
+        return quick_two_sum(s.hi, s.lo + t.lo);
+    }
+
+    constexpr dd mul(dd a, dd b)
+    {
+        const dd p = two_prod(a.hi, b.hi);
+        return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    constexpr dd div(dd a, dd b)
+    {
+        const double q1 = a.hi / b.hi;
+        dd r = add(a, mul(b, { -q1, 0 }));
+        const double q2 = r.hi / b.hi;
+        r = add(r, mul(b, { -q2, 0 }));
+        const double q3 = r.hi / b.hi;
+        return add(quick_two_sum(q1, q2), { q3, 0 });
+    }
+
+    constexpr dd LN2 = { 6.931471805599452862e-01, 2.319046813846299558e-17 };
+
+    //! @brief ln(x), x > 0 и конечно
+    constexpr dd log(double x)
+    {
+        //x = m * 2^e, m из [sqrt(1/2), sqrt(2)), ln(m) = 2*atanh((m-1)/(m+1))
+        int e = 0;
+        if (x < std::numeric_limits<double>::min())
+        {
+            x *= 18014398509481984.0;   //2^54
+            e = -54;
+        }
+        for (; x >= 1.4142135623730951; e++)
+            x /= 2;
+        for (; x < 0.7071067811865476; e--)
+            x *= 2;
 
-        try
+        const dd s = div({ x - 1, 0 }, two_sum(x, 1)), s2 = mul(s, s);
+        dd term = s, sum = s;
+        for (int i = 3; i < 64; i += 2)
         {
-            result = vars.at(token);
+            term = mul(term, s2);
+            sum = add(sum, div(term, { (double)i, 0 }));
         }
-        catch (...)
-        {            
-            result = 0;
+        return add({ 2 * sum.hi, 2 * sum.lo }, mul(LN2, { (double)e, 0 }));
+    }
+
+    //! @brief (hi + lo) * 2^k с одним округлением, в т.ч. до денормализованного числа; 0.5 <= v.hi < 2
+    constexpr double scale(dd v, int k)
+    {
+        if (k <= -1022)
+        {
+            //округление hi + lo сразу до кратного 2^-1074
+            const double s = pow2(k + 1074), h = v.hi * s;
+            double n = floor(h);
+            const double f = (h - n) + v.lo * s;
+            if (f > 0.5 || (f == 0.5 && floor(n / 2) * 2 != n))
+                n += 1;
+            return n * pow2(-1074);
         }
 
+        const double m = v.hi + v.lo;
+        if (k > 1024)
+            return INF;
+        if (k == 1024)
+        {
+            const double h = m * pow2(1023);
+            return h > DOUBLE_MAX / 2 ? INF : h * 2;
+        }
+        return m * pow2(k);
     }
-    else
+
+    //! @brief e^y, округленное до double; -746 < y.hi < 710
+    constexpr double exp(dd y)
+    {
+        //y = k*ln(2) + r, |r| <= ln(2)/2
+        const int k = (int)(y.hi / LN2.hi + (y.hi < 0 ? -0.5 : 0.5));
+        const dd r = add(y, mul(LN2, { (double)-k, 0 }));
+
+        dd term = { 1, 0 }, sum = { 1, 0 };
+        for (int i = 1; i < 28; i++)
+        {
+            term = div(mul(term, r), { (double)i, 0 });
+            sum = add(sum, term);
+        }
+
+        return scale(sum, k);
+    }
+
+    //! @brief a^b для a > 0, конечных a и b
+    constexpr double pow_positive(double a, double b)
+    {
+        if (a == 1)
+            return 1;
+        const dd l = log(a);
+        if (b > 1e300 || b < -1e300)    //|ln(a)| > 1e-16
+            return (l.hi > 0) == (b > 0) ? INF : 0;
+        const double y = l.hi * b;
+        if (y >= 710)
+            return INF;
+        if (y <= -746)
+            return 0;
+        return exp(mul(l, { b, 0 }));
+    }
+
+    //! @note особые случаи - как у pow() (C Annex F), в последнем знаке результат может отличаться от std::pow()
+    constexpr double pow(double a, double b)
+    {
+        if (b == 0 || a == 1)
+            return 1;
+        if (isnan(a) || isnan(b))
+            return NaN;
+        if (isinf(b))
+        {
+            if (a == -1)
+                return 1;
+            return (fabs(a) < 1) == (b > 0) ? 0 : INF;
+        }
+
+        const bool integer = floor(b) == b;
+        const bool odd = integer && fabs(b) < 9007199254740992.0 && floor(b / 2) * 2 != b;
+        if (a == 0 || isinf(a))
+        {
+            const bool large = isinf(a) == (b > 0);     //inf^+b, 0^-b
+            const double r = large ? INF : 0;
+            return odd && signbit(a) ? -r : r;
+        }
+        if (a < 0)
+        {
+            if (!integer)
+                return NaN;
+            const double r = pow_positive(-a, b);
+            return odd ? -r : r;
+        }
+        return pow_positive(a, b);
+    }
+
+    /**
+     * @brief Значение токена из цифр и '.', как atof(): число до второй '.'
+     * @note первые 30 значащих цифр; в последнем знаке результат может отличаться от std::from_chars()
+     */
+    constexpr double parse_double(const char* s, size_t len)
     {
-        result = (T)atof(token);
+        dd mant = { 0, 0 };
+        int exp10 = 0, digits = 0;
+        bool dot = false, rest = false;     //rest - отброшенные ненулевые цифры
+        for (size_t i = 0; i < len; i++)
+        {
+            if (s[i] == '.')
+            {
+                if (dot)
+                    break;
+                dot = true;
+                continue;
+            }
+            if (digits < 30)
+            {
+                mant = add(mul(mant, { 10, 0 }), { (double)(s[i] - '0'), 0 });
+                digits += mant.hi != 0;
+                exp10 -= dot;
+            }
+            else
+            {
+                rest = rest || s[i] != '0';
+                exp10 += !dot;
+            }
+        }
+
+        //mant * 10^exp10 из [10^(digits + exp10 - 1), 10^(digits + exp10))
+        if (mant.hi == 0 || digits + exp10 < -323)
+            return 0;
+        if (digits + exp10 > 309)
+            return INF;
+
+        const int n = exp10 < 0 ? -exp10 : exp10;
+        if (mant.hi < 9007199254740992.0 && n <= 22)    //mant и 10^n точны: одно округление
+        {
+            double p = 1;
+            for (int i = 0; i < n; i++)
+                p *= 10;
+            return exp10 < 0 ? mant.hi / p : mant.hi * p;
+        }
+
+        //v * 2^k, v.hi из [0.5, 2) после каждого шага
+        dd v = rest ? add(mant, { 0.5, 0 }) : mant;
+        int k = 0;
+        for (int i = 0; i <= n; i++)
+        {
+            if (i > 0)
+                v = exp10 < 0 ? div(v, { 10, 0 }) : mul(v, { 10, 0 });
+            for (; v.hi >= 2; k++)
+                v = { v.hi / 2, v.lo / 2 };
+            for (; v.hi < 0.5; k--)
+                v = { v.hi * 2, v.lo * 2 };
+        }
+        return scale(v, k);
     }
-    next_token();
+
+    /**
+     * @brief Разбор и вычисление выражения за один проход
+     * @note повторяет eval_exp5..atom и next_token() класса Calculator
+     */
+    template <typename T>
+    class parser
+    {
+    public:
+        constexpr parser(const char* exp, const calc_binding<T>* bindings, size_t bindings_count)
+            : _exp(exp), _bindings(bindings), _bindings_count(bindings_count) {}
+
+        constexpr T eval()
+        {
+            T result = 0;
+            return eval_exp5(result) ? result : 0;
+        }
+
+    private:
+        enum { NONE = 0, NUM, OP, VAR };
+
+        struct var
+        {
+            const char* name = nullptr;
+            size_t len = 0;
+            T value = 0;
+        };
+
+        const char* _exp;
+        const calc_binding<T>* _bindings;
+        size_t _bindings_count;
+
+        char _tok_type = NONE;
+        const char* _token = nullptr;
+        size_t _token_len = 0;
+        const char* _last_var = nullptr;
+        size_t _last_var_len = 0;
+
+        var _vars[MAX_CONSTEXPR_VARS] = {};     ///< присвоенные в выражении переменные
+        size_t _vars_count = 0;
+
+        static constexpr bool is_space(char ch) { return calc_token::classes[ch] == calc_token::CH_SPACE; }
+        static constexpr bool is_digit(char ch) { return calc_token::classes[ch] == calc_token::CH_DIGIT; }
+        static constexpr bool is_alpha(char ch) { return calc_token::classes[ch] == calc_token::CH_ALPHA; }
+        static constexpr bool is_operator(char ch) { return calc_token::classes[ch] == calc_token::CH_OP; }
+
+        //! @brief первый символ текущего токена (token[0] в Calculator)
+        constexpr char op() const { return _token ? *_token : 0; }
+
+        static constexpr bool same_name(const char* a, size_t a_len, const char* b, size_t b_len)
+        {
+            if (a_len != b_len)
+                return false;
+            for (size_t i = 0; i < a_len; i++)
+            {
+                if (a[i] != b[i])
+                    return false;
+            }
+            return true;
+        }
+
+        static constexpr size_t length(const char* s)
+        {
+            size_t len = 0;
+            while (s[len])
+                len++;
+            return len;
+        }
+
+        /**
+         * @brief Значение числа, во время выполнения - как в Calculator::atom()
+         * @return false, если целое значение не представимо в T
+         */
+        static constexpr bool number(const char* s, size_t len, T& r)
+        {
+            if (!CALC_CONSTANT_EVALUATED())
+                return calc_token::parse_number(s, s + len, r);
+            if constexpr (std::is_integral<T>::value)
+            {
+                r = 0;  //цифры до '.', как std::from_chars()
+                for (size_t i = 0; i < len && s[i] != '.'; i++)
+                {
+                    if (!calc_traits<T>::mul(r, 10, r) || !calc_traits<T>::add(r, (T)(s[i] - '0'), r))
+                        return false;
+                }
+            }
+            else
+                r = (T)parse_double(s, len);
+            return true;
+        }
+
+        constexpr T value(const char* name, size_t len) const
+        {
+            for (size_t i = 0; i < _vars_count; i++)
+            {
+                if (same_name(_vars[i].name, _vars[i].len, name, len))
+                    return _vars[i].value;
+            }
+            for (size_t i = 0; i < _bindings_count; i++)
+            {
+                if (same_name(_bindings[i].name, length(_bindings[i].name), name, len))
+                    return _bindings[i].value;
+            }
+            return 0;
+        }
+
+        constexpr bool assign(const char* name, size_t len, T val)
+        {
+            for (size_t i = 0; i < _vars_count; i++)
+            {
+                if (same_name(_vars[i].name, _vars[i].len, name, len))
+                {
+                    _vars[i].value = val;
+                    return true;
+                }
+            }
+            if (_vars_count == MAX_CONSTEXPR_VARS)
+                return too_many_variables();
+            _vars[_vars_count].name = name;
+            _vars[_vars_count].len = len;
+            _vars[_vars_count].value = val;
+            _vars_count++;
+            return true;
+        }
+
+        /**
+         * @brief Операция o ('_' - унарный минус) с проверками calc_traits, как в Calculator
+         * @note при компиляции плавающая точка - функциями calc_constexpr; деление на 0 и переполнение не являются
+         * константным выражением
+         */
+        static constexpr bool apply(char o, T a, T b, T& r)
+        {
+            if constexpr (std::is_floating_point<T>::value)
+            {
+                if (CALC_CONSTANT_EVALUATED())
+                {
+                    switch (o)
+                    {
+                    case '+': r = a + b; break;
+                    case '-': r = a - b; break;
+                    case '*': r = a * b; break;
+                    case '/': r = a / b; break;
+                    case '%': r = (T)fmod(floor((double)a), floor((double)b)); break;
+                    case '^': r = (T)pow((double)a, (double)b); break;
+                    case '!': r = (T)fact((double)a); break;
+                    case '_': r = -a; break;
+                    }
+                    return true;
+                }
+            }
+
+            typedef calc_traits<T> traits;
+            bool ok = false;
+            switch (o)
+            {
+            case '+': ok = traits::add(a, b, r); break;
+            case '-': ok = traits::sub(a, b, r); break;
+            case '*': ok = traits::mul(a, b, r); break;
+            case '/': ok = traits::div(a, b, r); break;
+            case '%': ok = traits::mod(a, b, r); break;
+            case '^': ok = traits::pow(a, b, r); break;
+            case '!': ok = traits::fact(a, r); break;
+            case '_': ok = traits::neg(a, r); break;
+            }
+            if (ok)
+                return true;
+            return ((o == '/' || o == '%') && b == 0) || (o == '^' && a == 0) ? division_by_zero() : overflow();
+        }
+
+        constexpr bool next_token()
+        {
+            while (is_space(*_exp))
+                _exp++;
+            if (*_exp == 0)
+            {
+                _tok_type = NONE;
+                return true;
+            }
+
+            const char* start = _exp;
+            if (is_digit(*_exp))
+            {
+                _tok_type = NUM;
+                while (is_digit(*_exp) || *_exp == '.')
+                    _exp++;
+            }
+            else if (is_alpha(*_exp))
+            {
+                _tok_type = VAR;
+                while (is_alpha(*_exp))
+                    _exp++;
+            }
+            else if (is_operator(*_exp))
+            {
+                _tok_type = OP;
+                _exp++;
+            }
+            else
+                return unknown_symbol();
+
+            _token = start;
+            _token_len = (size_t)(_exp - start);
+            return true;
+        }
+
+        constexpr bool eval_exp5(T& result)    // =
+        {
+            if (!next_token() || !eval_exp4(result))
+                return false;
+
+            if (_tok_type == OP && op() == '=')
+            {
+                if (!_last_var)
+                    return unexpected_operator();
+
+                const char* name = _last_var;
+                const size_t len = _last_var_len;
+                if (!next_token() || !eval_exp4(result))
+                    return false;
+                return assign(name, len, result);
+            }
+            return true;
+        }
+
+        constexpr bool eval_exp4(T& result)    // + -
+        {
+            if (!eval_exp3(result))
+                return false;
+
+            char o = op();
+            while (_tok_type == OP && (o == '+' || o == '-'))
+            {
+                T rhs = 0;
+                if (!next_token() || !eval_exp3(rhs) || !apply(o, result, rhs, result))
+                    return false;
+                o = op();
+            }
+            return true;
+        }
+
+        constexpr bool eval_exp3(T& result)    // * / %
+        {
+            if (!eval_exp2(result))
+                return false;
+
+            char o = op();
+            while (_tok_type == OP && (o == '*' || o == '/' || o == '%'))
+            {
+                T rhs = 0;
+                if (!next_token() || !eval_exp2(rhs) || !apply(o, result, rhs, result))
+                    return false;
+                o = op();
+            }
+            return true;
+        }
+
+        constexpr bool eval_exp2(T& result)    // + - Унарные
+        {
+            char o = '+';
+            if (_tok_type == OP && (op() == '+' || op() == '-'))
+            {
+                o = op();
+                if (!next_token())
+                    return false;
+            }
+
+            if (!eval_exp1(result))
+                return false;
+            if (o == '-')
+                return apply('_', result, 0, result);
+            return true;
+        }
+
+        constexpr bool eval_exp1(T& result)    // ^ !
+        {
+            if (!eval_exp0(result))
+                return false;
+
+            char o = op();
+            while (_tok_type == OP && (o == '^' || o == '!'))
+            {
+                if (!next_token())
+                    return false;
+                T rhs = 0;
+                if (o == '^' && !eval_exp1(rhs))
+                    return false;
+                if (!apply(o, result, rhs, result))
+                    return false;
+                o = op();
+            }
+            return true;
+        }
+
+        constexpr bool eval_exp0(T& result)    // ( )
+        {
+            if (_tok_type == OP && op() == '(')
+            {
+                if (!eval_exp5(result))
+                    return false;
+                if (!(_tok_type == OP && op() == ')'))
+                    return broken_balance_brackets();
+                return next_token();
+            }
+            return atom(result);
+        }
+
+        constexpr bool atom(T& result)
+        {
+            if (_tok_type == OP)
+                return unexpected_operator();
+            if (_tok_type == NONE)
+                return unexpected_end_of_expression();
+
+            if (_tok_type == VAR)
+            {
+                _last_var = _token;
+                _last_var_len = _token_len;
+                result = value(_token, _token_len);
+            }
+            else if (!number(_token, _token_len, result))
+                return overflow();
+            return next_token();
+        }
+    };
+} // namespace calc_constexpr
+
+/**
+ * @brief Вычисление выражения при компиляции: constexpr double v = calc_eval<double>("8/3*2");
+ * @note Грамматика и приоритеты операций - как у Calculator. Ошибка разбора в константном выражении -
+ * ошибка компиляции (вызов calc_constexpr::unexpected_operator() и т.п.), во время выполнения возвращается 0.
+ * Во время выполнения результат совпадает с Calculator<T>; при компиляции '^' и числа с плавающей точкой
+ * вычисляются функциями calc_constexpr и в редких случаях отличаются в последнем знаке.
+ * Если определён CALC_NO_CONSTANT_EVALUATED (компилятор без std::is_constant_evaluated() и
+ * __builtin_is_constant_evaluated()), функции calc_constexpr используются и во время выполнения
+ */
+template <typename T>
+constexpr T calc_eval(const char* exp)
+{
+    return calc_constexpr::parser<T>(exp, nullptr, 0).eval();
+}
+
+/**
+ * @brief Вычисление выражения с переменными при компиляции
+ * @code
+ * constexpr calc_binding<double> vars[] = { { "a", 2 }, { "b", 3 } };
+ * constexpr double v = calc_eval<double>("a*(b+2)", vars);    // 10
+ * @endcode
+ */
+template <typename T, size_t N>
+constexpr T calc_eval(const char* exp, const calc_binding<T> (&vars)[N])
+{
+    return calc_constexpr::parser<T>(exp, vars, N).eval();
 }
 
 #endif //!CALCULATOR_H
\ No newline at end of file
@@ -0,0 +1,509 @@
+/**
+ * @file calculator_jit.h
+ * @author Artem
+ * @brief Трансляция программ Calculator<double> и Calculator<int64_t> в машинный код x86-64
+ * @note Машинный код генерируется только на Linux x86-64. На остальных платформах, для других типов
+ * и для программ с глубиной стека больше числа регистров вычисление выполняет интерпретатор.
+ * Ошибки (переполнение и деление на 0 для целых) проверяются так же, как в интерпретаторе
+ * @version 0.1
+ * @date 2024-09-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/* Example
+#include "calculator_jit.h"
+int main()
+{
+	Calculator<double> calc;
+	Calculator<double>::program prog;
+	calc.compile("a*a + b/2", prog);
+
+	CalculatorJit<double> jit;
+	jit.compile(prog);		// false - вычисление интерпретатором
+
+	double slots[2] = { 3, 4 };
+	double r = jit(slots);	// 11
+
+	CalculatorJit<double>::function f = jit.native();	// nullptr без машинного кода
+	bool error = false;
+	if (f)
+		r = f(slots, &error);	// свой флаг ошибки: одну функцию можно вызывать из нескольких потоков
+	return 0;
+}
+*/
+
+#ifndef CALCULATOR_JIT_H
+#define CALCULATOR_JIT_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "calculator.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#define CALCULATOR_JIT_X64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+template <typename T>
+class CalculatorJit
+{
+public:
+	typedef T (*function)(T* slots, bool* error);	///< машинный код программы, slots - значения слотов, *error - ошибка
+	typedef typename Calculator<T>::program program;
+
+	CalculatorJit() : _mem(nullptr), _size(0), _code(nullptr), _was_error(false) {}
+	~CalculatorJit() { release(); }
+
+	CalculatorJit(const CalculatorJit&) = delete;
+	CalculatorJit& operator=(const CalculatorJit&) = delete;
+
+	/**
+	 * @brief Трансляция программы
+	 * @note программа копируется для вычисления интерпретатором
+	 * @return true - сгенерирован машинный код, false - вычисление интерпретатором
+	 */
+	bool compile(const program& prog);
+
+	/**
+	 * @brief машинный код программы или nullptr
+	 * @note функция записывает в *error признак ошибки и при ошибке возвращает 0; состояния объекта не меняет
+	 */
+	inline function native() const { return _code; }
+
+	/**
+	 * @brief Вычисление программы машинным кодом или интерпретатором
+	 * @param[inout] slots значения слотов (prog.slots_count() эл-в), сюда же записываются присваивания
+	 * @note устанавливает was_error(); для вычислений из нескольких потоков - operator()(slots, error)
+	 */
+	T operator()(T* slots)
+	{
+		return (*this)(slots, _was_error);
+	}
+
+	//! @brief Вычисление с флагом ошибки вызывающего: объект не меняется, вызовы из разных потоков независимы
+	T operator()(T* slots, bool& error) const
+	{
+		if (_code)
+			return _code(slots, &error);
+
+		thread_local std::vector<T> stack;	//стек интерпретатора, свой у каждого потока
+		T result = 0;
+		error = _prog.empty() || Calculator<T>::run(_prog, slots, result, stack) != Calculator<T>::ERR_NONE;
+		return error ? 0 : result;
+	}
+
+	//! @brief ошибка последнего вычисления
+	inline bool was_error() const { return _was_error; }
+
+private:
+	typedef Calculator<T> calc;
+
+	void release()
+	{
+#if defined(CALCULATOR_JIT_X64)
+		if (_mem)
+			munmap(_mem, _size);
+#endif
+		_mem = nullptr;
+		_size = 0;
+		_code = nullptr;
+	}
+
+#if defined(CALCULATOR_JIT_X64)
+	enum REGS { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+	static const bool is_fp = std::is_floating_point<T>::value;
+
+	/// \note позиция стека программы постоянно хранится в регистре: xmm2..xmm15 для double,
+	/// r8..r11, rsi, rcx для int64_t. Указатель на слоты - rbx, временные ячейки и указатель на флаг
+	/// ошибки (второй аргумент функции) - в кадре стека
+	static int reg(uint32_t pos)
+	{
+		static const int gpr[] = { R8, R9, R10, R11, RSI, RCX };
+		return is_fp ? (int)pos + 2 : gpr[pos];
+	}
+
+	static inline uint32_t regs_count() { return is_fp ? 14 : 6; }
+
+	bool generate(const program& prog);
+	bool map_code();
+
+	inline void byte(uint8_t b) { _buf.push_back(b); }
+
+	inline void dword(uint32_t v)
+	{
+		for (int i = 0; i < 4; i++)
+			byte((uint8_t)(v >> (8 * i)));
+	}
+
+	inline void qword(uint64_t v)
+	{
+		for (int i = 0; i < 8; i++)
+			byte((uint8_t)(v >> (8 * i)));
+	}
+
+	//! @brief префикс, REX, код операции (ext - двухбайтовый код 0F xx)
+	void opcode(uint8_t prefix, bool w, bool ext, uint8_t op, int reg, int rm)
+	{
+		if (prefix)
+			byte(prefix);
+		uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+		if (rex != 0x40)
+			byte(rex);
+		if (ext)
+			byte(0x0F);
+		byte(op);
+	}
+
+	//! @brief операнды регистр, регистр
+	void op_rr(uint8_t prefix, bool w, bool ext, uint8_t op, int reg, int rm)
+	{
+		opcode(prefix, w, ext, op, reg, rm);
+		byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+	}
+
+	//! @brief операнды регистр, [base + disp]
+	void op_rm(uint8_t prefix, bool w, bool ext, uint8_t op, int reg, int base, int32_t disp)
+	{
+		opcode(prefix, w, ext, op, reg, base);
+		byte(0x80 | (reg & 7) << 3 | (base & 7));
+		if ((base & 7) == RSP)
+			byte(0x24);
+		dword((uint32_t)disp);
+	}
+
+	//! @brief операнды регистр, [rip + disp], target - смещение данных от начала кода
+	void op_rip(uint8_t prefix, bool w, bool ext, uint8_t op, int reg, size_t target)
+	{
+		opcode(prefix, w, ext, op, reg, 0);
+		byte(0x05 | (reg & 7) << 3);
+		dword((uint32_t)(target - (_buf.size() + 4)));
+	}
+
+	inline void load(int r, int base, int32_t disp)
+	{
+		if (is_fp)
+			op_rm(0xF2, false, true, 0x10, r, base, disp);	// movsd
+		else
+			op_rm(0, true, false, 0x8B, r, base, disp);		// mov
+	}
+
+	inline void store(int base, int32_t disp, int r)
+	{
+		if (is_fp)
+			op_rm(0xF2, false, true, 0x11, r, base, disp);	// movsd
+		else
+			op_rm(0, true, false, 0x89, r, base, disp);		// mov
+	}
+
+	//! @brief указатель на флаг ошибки из кадра в r
+	inline void load_error_ptr(int r)
+	{
+		op_rm(0, true, false, 0x8B, r, RSP, _error_slot);	// mov r, [rsp + _error_slot]
+	}
+
+	inline void move(int dst, int src)
+	{
+		if (dst == src)
+			return;
+		if (is_fp)
+			op_rr(0x66, false, true, 0x28, dst, src);		// movapd
+		else
+			op_rr(0, true, false, 0x8B, dst, src);			// mov
+	}
+
+	inline void mov_imm(int r, uint64_t v)
+	{
+		opcode(0, true, false, 0xB8 + (r & 7), 0, r);	// mov r64, imm64
+		qword(v);
+	}
+
+	//! @brief переход (cc - условие 0F 8x, 0 - безусловный), возвращает место смещения для patch()
+	size_t jump(uint8_t cc)
+	{
+		if (cc)
+		{
+			byte(0x0F);
+			byte(cc);
+		}
+		else
+			byte(0xE9);
+		dword(0);
+		return _buf.size() - 4;
+	}
+
+	//! @brief направить переход на текущее место кода
+	void patch(size_t pos)
+	{
+		const uint32_t rel = (uint32_t)(_buf.size() - (pos + 4));
+		memcpy(&_buf[pos], &rel, 4);
+	}
+
+	inline void jump_error(uint8_t cc) { _errors.push_back(jump(cc)); }
+
+	//! @brief операция калькулятора для машинного кода, ошибка записывается в *error
+	template <uint8_t OP>
+	static T helper(T a, T b, bool* error)
+	{
+		T res = 0;
+		if (!calc::apply(OP, a, b, res))
+			*error = true;
+		return res;
+	}
+
+	void arith(uint8_t op, int dst, int src);
+	void call(T (*fn)(T, T, bool*), uint32_t a, uint32_t b);
+	void epilogue(uint32_t frame);
+
+	std::vector<uint8_t> _buf;	///< генерируемый код
+	size_t _entry;				///< начало функции в _buf (перед ней пул констант)
+	int32_t _error_slot;		///< смещение указателя на флаг ошибки в кадре
+	std::vector<size_t> _errors;	///< переходы на выход с ошибкой
+#endif
+
+	void* _mem;		///< страницы с машинным кодом
+	size_t _size;
+	function _code;
+	program _prog;	///< программа для интерпретатора
+	bool _was_error;
+};
+
+template <typename T>
+bool CalculatorJit<T>::compile(const program& prog)
+{
+	release();
+	_prog = prog;
+#if defined(CALCULATOR_JIT_X64)
+	if (!std::is_same<T, double>::value && !std::is_same<T, int64_t>::value)
+		return false;
+	if (prog.empty() || prog.stack_size > regs_count())
+		return false;
+	bool ok = generate(prog) && map_code();
+	std::vector<uint8_t>().swap(_buf);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+#if defined(CALCULATOR_JIT_X64)
+
+template <typename T>
+bool CalculatorJit<T>::generate(const program& prog)
+{
+	// пул констант: маска знака для xorpd (выравнивание 16), значения OP_CONST
+	_buf.assign(16, 0);
+	_buf[7] = _buf[15] = 0x80;
+	std::vector<size_t> consts;
+	for (const auto& in : prog.code)
+	{
+		if (in.op != calc::OP_CONST)
+			continue;
+		consts.push_back(_buf.size());
+		_buf.resize(_buf.size() + sizeof(T));
+		memcpy(&_buf[consts.back()], &in.value, sizeof(T));
+	}
+	while (_buf.size() % 16)
+		byte(0xCC);
+	_entry = _buf.size();
+
+	// кадр: сохранение регистров при вызовах, временные ячейки, указатель на флаг ошибки;
+	// rsp выровнен на 16 после push rbx
+	const uint32_t spill = regs_count();
+	const uint32_t frame = ((spill + prog.temps_count + 1) * 8 + 15) & ~15u;
+	_error_slot = (int32_t)((spill + prog.temps_count) * 8);
+
+	byte(0x53);								// push rbx
+	op_rr(0, true, false, 0x89, RDI, RBX);	// mov rbx, rdi
+	byte(0x48); byte(0x81); byte(0xEC);		// sub rsp, frame
+	dword(frame);
+	op_rm(0, true, false, 0x89, RSI, RSP, _error_slot);	// mov [rsp + _error_slot], rsi
+	byte(0xC6); byte(0x06); byte(0x00);		// mov byte [rsi], 0
+
+	_errors.clear();
+	uint32_t sp = 0;
+	size_t c = 0;
+	for (const auto& in : prog.code)
+	{
+		switch (in.op)
+		{
+		case calc::OP_CONST:
+			if (is_fp)
+				op_rip(0xF2, false, true, 0x10, reg(sp++), consts[c++]);
+			else
+				op_rip(0, true, false, 0x8B, reg(sp++), consts[c++]);
+			break;
+		case calc::OP_LOAD:
+			load(reg(sp++), RBX, (int32_t)(in.arg * sizeof(T)));
+			break;
+		case calc::OP_STORE:
+			store(RBX, (int32_t)(in.arg * sizeof(T)), reg(sp - 1));
+			break;
+		case calc::OP_DROP:
+			sp--;
+			break;
+		case calc::OP_ADD:
+		case calc::OP_SUB:
+		case calc::OP_MUL:
+		case calc::OP_DIV:
+			sp--;
+			arith(in.op, reg(sp - 1), reg(sp));
+			break;
+		case calc::OP_MOD:
+			sp--;
+			call(&helper<calc::OP_MOD>, sp - 1, sp);
+			break;
+		case calc::OP_POW:
+			sp--;
+			call(&helper<calc::OP_POW>, sp - 1, sp);
+			break;
+		case calc::OP_FACT:
+			call(&helper<calc::OP_FACT>, sp - 1, sp - 1);
+			break;
+		case calc::OP_NEG:
+			if (is_fp)
+				op_rip(0x66, false, true, 0x57, reg(sp - 1), 0);	// xorpd с маской знака
+			else
+			{
+				op_rr(0, true, false, 0xF7, 3, reg(sp - 1));		// neg
+				jump_error(0x80);									// jo
+			}
+			break;
+		case calc::OP_SAVE:
+			store(RSP, (int32_t)((spill + in.arg) * 8), reg(sp - 1));
+			break;
+		case calc::OP_RECALL:
+			load(reg(sp++), RSP, (int32_t)((spill + in.arg) * 8));
+			break;
+		default:
+			return false;
+		}
+	}
+
+	move(0, reg(sp - 1));					// результат в xmm0 / rax
+	epilogue(frame);
+
+	if (!_errors.empty())
+	{
+		for (size_t pos : _errors)
+			patch(pos);
+		load_error_ptr(RAX);
+		byte(0xC6); byte(0x00); byte(0x01);		// mov byte [rax], 1
+		byte(0x31); byte(0xC0);					// xor eax, eax
+		op_rr(0x66, false, true, 0x57, 0, 0);	// xorpd xmm0, xmm0
+		epilogue(frame);
+	}
+	return true;
+}
+
+template <typename T>
+void CalculatorJit<T>::epilogue(uint32_t frame)
+{
+	byte(0x48); byte(0x81); byte(0xC4);		// add rsp, frame
+	dword(frame);
+	byte(0x5B);								// pop rbx
+	byte(0xC3);								// ret
+}
+
+template <typename T>
+void CalculatorJit<T>::arith(uint8_t op, int dst, int src)
+{
+	if (is_fp)
+	{
+		static const uint8_t codes[] = { 0x58, 0x5C, 0x59, 0x5E };	// addsd subsd mulsd divsd
+		op_rr(0xF2, false, true, codes[op - calc::OP_ADD], dst, src);
+		return;
+	}
+
+	switch (op)
+	{
+	case calc::OP_ADD:
+		op_rr(0, true, false, 0x03, dst, src);
+		jump_error(0x80);						// jo
+		break;
+	case calc::OP_SUB:
+		op_rr(0, true, false, 0x2B, dst, src);
+		jump_error(0x80);
+		break;
+	case calc::OP_MUL:
+		op_rr(0, true, true, 0xAF, dst, src);	// imul
+		jump_error(0x80);
+		break;
+	case calc::OP_DIV:
+	{
+		op_rr(0, true, false, 0x85, src, src);	// test src, src
+		jump_error(0x84);						// je - деление на 0
+		op_rr(0, true, false, 0x83, 7, src);	// cmp src, -1
+		byte(0xFF);
+		size_t divide = jump(0x85);				// jne
+		op_rr(0, true, false, 0xF7, 3, dst);	// neg dst (INT64_MIN / -1 - переполнение)
+		jump_error(0x80);
+		size_t done = jump(0);
+		patch(divide);
+		move(RAX, dst);
+		byte(0x48); byte(0x99);					// cqo
+		op_rr(0, true, false, 0xF7, 7, src);	// idiv
+		move(dst, RAX);
+		patch(done);
+		break;
+	}
+	}
+}
+
+/**
+ * @brief Вызов fn(reg(a), reg(b), error), результат в reg(a); error - второй аргумент функции
+ * @note регистры нижних позиций стека сохраняются в кадре на время вызова
+ */
+template <typename T>
+void CalculatorJit<T>::call(T (*fn)(T, T, bool*), uint32_t a, uint32_t b)
+{
+	for (uint32_t i = 0; i < a; i++)
+		store(RSP, (int32_t)(i * 8), reg(i));
+
+	move(is_fp ? 0 : RDI, reg(a));
+	move(is_fp ? 1 : RSI, reg(b));
+	load_error_ptr(is_fp ? RDI : RDX);
+	mov_imm(RAX, (uint64_t)(uintptr_t)fn);
+	byte(0xFF); byte(0xD0);		// call rax
+
+	for (uint32_t i = 0; i < a; i++)
+		load(reg(i), RSP, (int32_t)(i * 8));
+	move(reg(a), 0);
+
+	load_error_ptr(RAX);
+	byte(0x80); byte(0x38); byte(0x00);	// cmp byte [rax], 0
+	jump_error(0x85);					// jne
+}
+
+template <typename T>
+bool CalculatorJit<T>::map_code()
+{
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t size = (_buf.size() + page - 1) / page * page;
+
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return false;
+
+	memcpy(mem, _buf.data(), _buf.size());
+	if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(mem, size);
+		return false;
+	}
+
+	_mem = mem;
+	_size = size;
+	_code = (function)((uint8_t*)mem + _entry);
+	return true;
+}
+
+#endif // CALCULATOR_JIT_X64
+
+#endif // CALCULATOR_JIT_H
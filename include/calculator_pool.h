@@ -0,0 +1,219 @@
+/**
+ * @file calculator_pool.h
+ * @author Artem
+ * @brief Параллельное вычисление множества независимых выражений Calculator<T>
+ * @note Выражения делятся на порции по CALC_POOL_CHUNK, потоки пула забирают порции по мере освобождения.
+ * У каждого потока свой разборщик, значения переменных берутся из общего снимка только для чтения
+ * @version 0.1
+ * @date 2024-09-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/* Example
+#include "calculator_pool.h"
+int main()
+{
+	Calculator<double> calc;
+	calc("a = 2");
+	calc("b = 3");
+
+	std::vector<std::string> exps = { "a*b", "a + b*10", "c = a^b", "a $ b" };
+	CalculatorPool<double> pool;	// по числу ядер
+	auto res = pool.eval(calc, exps);	// { 0, 6 }, { 1, 32 }, { 2, 8 }, { 3, 0, ERR_UNKNOWN }
+	// присваивание "c = a^b" не изменяет переменные calc
+	return 0;
+}
+*/
+
+#ifndef CALCULATOR_POOL_H
+#define CALCULATOR_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "calculator.h"
+
+#define CALC_POOL_CHUNK 64	///< число выражений, забираемых потоком за раз
+
+template <typename T>
+class CalculatorPool
+{
+public:
+	typedef typename Calculator<T>::statement_result result;	///< index - номер выражения во входном списке
+
+	/**
+	 * @param threads число потоков вместе с вызывающим, 0 - по числу ядер
+	 */
+	explicit CalculatorPool(unsigned threads = 0)
+		: _job(0), _running(0), _stop(false), _snapshot(nullptr), _exps(nullptr), _count(0), _out(nullptr), _next(0)
+	{
+		if (!threads)
+			threads = std::thread::hardware_concurrency();
+		if (!threads)
+			threads = 1;
+
+		_workers = std::vector<worker>(threads);
+		for (unsigned i = 1; i < threads; i++)
+			_threads.emplace_back(&CalculatorPool::loop, this, i);
+	}
+
+	~CalculatorPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_start.notify_all();
+		for (std::thread& th : _threads)
+			th.join();
+	}
+
+	CalculatorPool(const CalculatorPool&) = delete;
+	CalculatorPool& operator=(const CalculatorPool&) = delete;
+
+	inline unsigned size() const { return (unsigned)_workers.size(); }
+
+	/**
+	 * @brief Вычисление выражений на переменных калькулятора
+	 * @note Значения переменных копируются один раз за вызов, присваивания в выражениях их не изменяют.
+	 * На время вызова calc не должен изменяться. Вызовы eval() одного пула не должны пересекаться
+	 *
+	 * @param[in] calc калькулятор с переменными
+	 * @param[in] exps выражения (n эл-в)
+	 * @param[out] out результаты в порядке выражений (n эл-в)
+	 * @param[in] n число выражений
+	 */
+	void eval(const Calculator<T>& calc, const char* const* exps, result* out, size_t n);
+
+	std::vector<result> eval(const Calculator<T>& calc, const std::vector<std::string>& exps);
+
+private:
+	//! @brief состояние потока: разборщик и буферы программы
+	struct worker
+	{
+		Calculator<T> parser;
+		typename Calculator<T>::program prog;
+		std::vector<T> slots;
+	};
+
+	void loop(unsigned id);
+	void work(worker& w);
+
+	std::vector<worker> _workers;		///< [0] - вызывающий поток
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _start;		///< новое задание или остановка
+	std::condition_variable _done;		///< все потоки закончили задание
+	uint64_t _job;						///< номер задания
+	unsigned _running;					///< потоков, не закончивших задание
+	bool _stop;
+
+	// текущее задание
+	const typename Calculator<T>::context* _snapshot;
+	const char* const* _exps;
+	size_t _count;
+	result* _out;
+	std::atomic<size_t> _next;			///< первое не розданное выражение
+};
+
+template <typename T>
+void CalculatorPool<T>::eval(const Calculator<T>& calc, const char* const* exps, result* out, size_t n)
+{
+	const typename Calculator<T>::context snapshot = calc.make_context();
+	_snapshot = &snapshot;
+	_exps = exps;
+	_count = n;
+	_out = out;
+	_next.store(0, std::memory_order_relaxed);
+
+	const bool parallel = !_threads.empty() && n > CALC_POOL_CHUNK;
+	if (parallel)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = (unsigned)_threads.size();
+			_job++;
+		}
+		_start.notify_all();
+	}
+
+	work(_workers[0]);
+
+	if (parallel)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this] { return _running == 0; });
+	}
+	_snapshot = nullptr;
+}
+
+template <typename T>
+std::vector<typename CalculatorPool<T>::result> CalculatorPool<T>::eval(const Calculator<T>& calc, const std::vector<std::string>& exps)
+{
+	std::vector<const char*> ptrs(exps.size());
+	for (size_t i = 0; i < exps.size(); i++)
+		ptrs[i] = exps[i].c_str();
+
+	std::vector<result> out(exps.size());
+	eval(calc, ptrs.data(), out.data(), out.size());
+	return out;
+}
+
+template <typename T>
+void CalculatorPool<T>::loop(unsigned id)
+{
+	uint64_t job = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_start.wait(lock, [&] { return _stop || _job != job; });
+			if (_stop)
+				return;
+			job = _job;
+		}
+
+		work(_workers[id]);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_running == 0)
+			_done.notify_one();
+	}
+}
+
+template <typename T>
+void CalculatorPool<T>::work(worker& w)
+{
+	for (;;)
+	{
+		const size_t begin = _next.fetch_add(CALC_POOL_CHUNK, std::memory_order_relaxed);
+		if (begin >= _count)
+			return;
+		const size_t end = begin + CALC_POOL_CHUNK < _count ? begin + CALC_POOL_CHUNK : _count;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			result& res = _out[i];
+			res.index = (uint32_t)i;
+			res.value = 0;
+			if (w.parser.compile(_exps[i], w.prog))
+			{
+				//слоты программы - по именам из снимка, разборщик переменных не хранит
+				w.slots.resize(w.prog.slots_count());
+				for (uint32_t s = 0; s < w.prog.slots_count(); s++)
+					w.slots[s] = _snapshot->get(w.prog.slot_name(s));
+				res.value = w.parser.eval(w.prog, w.slots.data());
+			}
+			res.error = w.parser.error_code();
+		}
+	}
+}
+
+#endif // CALCULATOR_POOL_H
@@ -2,6 +2,7 @@
 #define FILE_MODULE_H
 
 #include <string>
+#include <fstream>
 
 namespace io_api
 {
@@ -77,7 +78,7 @@ namespace io_api
         return 0;
     }
 
-    uint32_t get_file_size(const char* file)
+    inline uint32_t get_file_size(const char* file)
     {		
         int64_t size = 0;
 
@@ -10,11 +10,19 @@
 #include <string>
 #include "calculator.h"
 
+#if defined(HEADER_REBUILDER_FIXED_POINT)
+#include "math/fixed_point.h"
+#endif
+
 namespace io_api
 {
 	namespace header
 	{
+#if defined(HEADER_REBUILDER_FIXED_POINT)
+		typedef math::fixed_point<31, 32> value_type;	///<   FPU
+#else
 		typedef double value_type;
+#endif
 		void parse_file(const std::string& file_input, Calculator<value_type>& math);
 		void write_file(const std::string& output_dir, const std::string& base_file, const Calculator<value_type>& math);
 	}//header
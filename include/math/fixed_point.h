@@ -0,0 +1,275 @@
+/**
+ * @file fixed_point.h
+ * @author Artem
+ * @brief Число с фиксированной точкой для платформ без FPU
+ * @note fixed_point<IntBits, FracBits>: знак, IntBits бит целой части и FracBits бит дробной.
+ * Хранение в int32_t при IntBits + FracBits <= 31, иначе в int64_t (нужен __int128).
+ * Операторы + - * / насыщаются до границ диапазона, функции add()..fact() дополнительно
+ * возвращают false при переполнении - так ошибки видит Calculator<fixed_point<...>> (ERR_OVER)
+ * @version 0.1
+ * @date 2024-09-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/* Example
+#include "math/fixed_point.h"
+int main()
+{
+	typedef math::fixed_point<15, 16> fixed;	// Q15.16, int32_t
+
+	fixed a(1.5), b(2);
+	fixed c = a * b + fixed(0.25);		// 3.25
+	double d = c.to_double();
+
+	Calculator<fixed> calc;
+	fixed r = calc("x = 2.5 * 4 - 3 % 2");	// 9
+	r = calc("x * 30000");					// calc.was_error() == true (ERR_OVER)
+	return 0;
+}
+*/
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+
+#include "../calculator.h"
+
+namespace math
+{
+	template <int IntBits, int FracBits>
+	class fixed_point
+	{
+		static_assert(IntBits >= 1 && FracBits >= 1 && IntBits + FracBits <= 63, "fixed_point: 1..63 bits");
+
+		static constexpr bool narrow = IntBits + FracBits <= 31;
+
+	public:
+		typedef typename std::conditional<narrow, int32_t, int64_t>::type raw_type;	///< хранение значения
+#if defined(__SIZEOF_INT128__)
+		typedef typename std::conditional<narrow, int64_t, __int128>::type wide_type;	///< промежуточные результаты
+#else
+		static_assert(narrow, "fixed_point: IntBits + FracBits > 31 requires __int128");
+		typedef int64_t wide_type;
+#endif
+
+		static constexpr raw_type one = (raw_type)1 << FracBits;	///< 1.0
+		static constexpr raw_type max_raw = (raw_type)(((wide_type)1 << (IntBits + FracBits)) - 1);
+		static constexpr raw_type min_raw = -max_raw - 1;
+
+		fixed_point() = default;	///< без инициализации, как у встроенных типов
+		constexpr fixed_point(int v) : _raw(clamp((wide_type)v * one)) {}
+		explicit constexpr fixed_point(double v) : _raw(from_double(v)) {}
+
+		static constexpr fixed_point from_raw(raw_type raw)
+		{
+			fixed_point f{};
+			f._raw = raw;
+			return f;
+		}
+
+		static constexpr fixed_point max() { return from_raw(max_raw); }
+		static constexpr fixed_point min() { return from_raw(min_raw); }
+
+		constexpr raw_type raw() const { return _raw; }
+		constexpr double to_double() const { return (double)_raw / one; }
+		explicit constexpr operator double() const { return to_double(); }
+
+		// Операции с проверкой: false - переполнение или деление на 0, r насыщается (при делении на 0 не изменяется)
+
+		static constexpr bool add(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			return saturate((wide_type)a._raw + b._raw, r);
+		}
+
+		static constexpr bool sub(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			return saturate((wide_type)a._raw - b._raw, r);
+		}
+
+		//! @note округление к ближайшему
+		static constexpr bool mul(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			return saturate(((wide_type)a._raw * b._raw + (one >> 1)) >> FracBits, r);
+		}
+
+		//! @note отбрасывание дробной части, как у целых
+		static constexpr bool div(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			if (b._raw == 0)
+				return false;
+			return saturate((wide_type)a._raw * one / b._raw, r);
+		}
+
+		static constexpr bool neg(fixed_point a, fixed_point& r)
+		{
+			return saturate(-(wide_type)a._raw, r);
+		}
+
+		//! @brief остаток от деления целых частей, как fmod(floor(a), floor(b))
+		static constexpr bool mod(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			const wide_type ib = floor_int(b);
+			if (ib == 0)
+				return false;
+			r._raw = (raw_type)(floor_int(a) % ib * one);
+			return true;
+		}
+
+		/**
+		 * @brief a^b: целая степень - умножениями с проверкой, дробная - через std::pow с double
+		 * @note отрицательная степень - 1 / a^|b|, 0^(-n) - ошибка
+		 */
+		static constexpr bool pow(fixed_point a, fixed_point b, fixed_point& r)
+		{
+			if (b._raw & (one - 1))
+				return saturate_double(std::pow(a.to_double(), b.to_double()), r);
+
+			wide_type n = b._raw / one;
+			const bool inverse = n < 0;
+			if (inverse)
+				n = -n;
+
+			fixed_point x = a, p = 1;
+			bool ok = true;		// после переполнения значения насыщены, знак результата сохраняется
+			while (n)
+			{
+				if (n & 1)
+					ok = mul(p, x, p) && ok;
+				n >>= 1;
+				if (n)
+					ok = mul(x, x, x) && ok;
+			}
+
+			if (!inverse)
+			{
+				r = p;
+				return ok;
+			}
+			if (!ok)	// 1 / (вне диапазона)
+			{
+				r = 0;
+				return true;
+			}
+			return div(1, p, r);
+		}
+
+		//! @brief |floor(a)|!
+		static constexpr bool fact(fixed_point a, fixed_point& r)
+		{
+			wide_type n = floor_int(a);
+			if (n < 0)
+				n = -n;
+			wide_type f = 1;
+			for (wide_type i = 2; i <= n; i++)
+			{
+				f *= i;
+				if (f > (max_raw >> FracBits))
+				{
+					r = max();
+					return false;
+				}
+			}
+			r._raw = (raw_type)(f * one);
+			return true;
+		}
+
+		// Насыщающие операторы
+
+		friend constexpr fixed_point operator+(fixed_point a, fixed_point b) { add(a, b, a); return a; }
+		friend constexpr fixed_point operator-(fixed_point a, fixed_point b) { sub(a, b, a); return a; }
+		friend constexpr fixed_point operator*(fixed_point a, fixed_point b) { mul(a, b, a); return a; }
+
+		//! @note x / 0 - максимум со знаком x
+		friend constexpr fixed_point operator/(fixed_point a, fixed_point b)
+		{
+			if (!div(a, b, a))
+				a = a._raw < 0 ? min() : max();
+			return a;
+		}
+
+		constexpr fixed_point operator-() const
+		{
+			fixed_point r{};
+			neg(*this, r);
+			return r;
+		}
+
+		constexpr fixed_point& operator+=(fixed_point b) { return *this = *this + b; }
+		constexpr fixed_point& operator-=(fixed_point b) { return *this = *this - b; }
+		constexpr fixed_point& operator*=(fixed_point b) { return *this = *this * b; }
+		constexpr fixed_point& operator/=(fixed_point b) { return *this = *this / b; }
+
+		friend constexpr bool operator==(fixed_point a, fixed_point b) { return a._raw == b._raw; }
+		friend constexpr bool operator!=(fixed_point a, fixed_point b) { return a._raw != b._raw; }
+		friend constexpr bool operator<(fixed_point a, fixed_point b) { return a._raw < b._raw; }
+		friend constexpr bool operator>(fixed_point a, fixed_point b) { return a._raw > b._raw; }
+		friend constexpr bool operator<=(fixed_point a, fixed_point b) { return a._raw <= b._raw; }
+		friend constexpr bool operator>=(fixed_point a, fixed_point b) { return a._raw >= b._raw; }
+
+	private:
+		static constexpr raw_type clamp(wide_type v)
+		{
+			return v > max_raw ? max_raw : v < min_raw ? min_raw : (raw_type)v;
+		}
+
+		static constexpr bool saturate(wide_type v, fixed_point& r)
+		{
+			r._raw = clamp(v);
+			return r._raw == v;
+		}
+
+		static constexpr raw_type from_double(double v)
+		{
+			const double s = v * one;
+			if (!(s == s))	// NaN
+				return 0;
+			if (s >= (double)max_raw)
+				return max_raw;
+			if (s <= (double)min_raw)
+				return min_raw;
+			return (raw_type)(s < 0 ? s - 0.5 : s + 0.5);
+		}
+
+		static constexpr bool saturate_double(double v, fixed_point& r)
+		{
+			r._raw = from_double(v);
+			return v == v && v * one < (double)max_raw && v * one > (double)min_raw;
+		}
+
+		//! @brief floor(a) целым числом
+		static constexpr wide_type floor_int(fixed_point a)
+		{
+			return (a._raw - (a._raw & (one - 1))) / one;
+		}
+
+		raw_type _raw;
+	};
+}
+
+/**
+ * @brief Calculator<math::fixed_point<...>>: операции с проверкой переполнения, без SIMD
+ * @note 0^(-n) и деление на 0 - ERR_DIV, переполнение - ERR_OVER
+ */
+template <int IntBits, int FracBits>
+struct calc_traits<math::fixed_point<IntBits, FracBits>>
+{
+	typedef math::fixed_point<IntBits, FracBits> T;
+
+	static constexpr bool vector = false;
+
+	static constexpr bool add(T a, T b, T& r) { return T::add(a, b, r); }
+	static constexpr bool sub(T a, T b, T& r) { return T::sub(a, b, r); }
+	static constexpr bool mul(T a, T b, T& r) { return T::mul(a, b, r); }
+	static constexpr bool div(T a, T b, T& r) { return T::div(a, b, r); }
+	static constexpr bool neg(T a, T& r) { return T::neg(a, r); }
+	static constexpr bool mod(T a, T b, T& r) { return T::mod(a, b, r); }
+	static constexpr bool pow(T a, T b, T& r) { return T::pow(a, b, r); }
+	static constexpr bool fact(T a, T& r) { return T::fact(a, r); }
+};
+
+#endif // FIXED_POINT_H
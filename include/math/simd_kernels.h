@@ -0,0 +1,177 @@
+/**
+ * @file simd_kernels.h
+ * @author Artem
+ * @brief Поэлементные операции над массивами с использованием SSE2/AVX
+ * @note Набор инструкций выбирается при сборке: AVX (-mavx2, /arch:AVX2), иначе SSE2 (x86-64),
+ * иначе скалярный цикл. Для типов, отличных от double, используется скалярный цикл
+ * @version 0.1
+ * @date 2024-09-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/* Example
+#include "math/simd_kernels.h"
+int main()
+{
+	double a[5] = { 1,2,3,4,5 };
+	double b[5] = { 5,4,3,2,1 };
+	double r[5];
+	math::simd::add(a, b, r, 5);	// r = { 6,6,6,6,6 }
+	math::simd::mul(r, a, r, 5);	// допустимо r == a
+	return 0;
+}
+*/
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <stddef.h>
+#include <cmath>
+
+#if defined(__AVX__)
+#define SIMD_KERNELS_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace math
+{
+	namespace simd
+	{
+		/// \note результат r может совпадать с любым из аргументов
+
+		template<typename T>
+		inline void add(const T* a, const T* b, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = a[i] + b[i];
+		}
+
+		template<typename T>
+		inline void sub(const T* a, const T* b, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = a[i] - b[i];
+		}
+
+		template<typename T>
+		inline void mul(const T* a, const T* b, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = a[i] * b[i];
+		}
+
+		template<typename T>
+		inline void div(const T* a, const T* b, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = a[i] / b[i];
+		}
+
+		template<typename T>
+		inline void neg(const T* a, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = -a[i];
+		}
+
+		//! @note векторного pow в SSE2/AVX нет, используется скалярный цикл
+		template<typename T>
+		inline void pow(const T* a, const T* b, T* r, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = (T)std::pow(a[i], b[i]);
+		}
+
+		template<typename T>
+		inline void fill(T* r, T val, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				r[i] = val;
+		}
+
+#if defined(SIMD_KERNELS_AVX)
+
+#define SIMD_KERNEL_BINARY(name, intrin, op)                                    \
+		inline void name(const double* a, const double* b, double* r, size_t n) \
+		{                                                                       \
+			size_t i = 0;                                                       \
+			for (; i + 4 <= n; i += 4)                                          \
+				_mm256_storeu_pd(r + i, intrin(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+			for (; i < n; i++)                                                  \
+				r[i] = a[i] op b[i];                                            \
+		}
+
+		SIMD_KERNEL_BINARY(add, _mm256_add_pd, +)
+		SIMD_KERNEL_BINARY(sub, _mm256_sub_pd, -)
+		SIMD_KERNEL_BINARY(mul, _mm256_mul_pd, *)
+		SIMD_KERNEL_BINARY(div, _mm256_div_pd, /)
+#undef SIMD_KERNEL_BINARY
+
+		inline void neg(const double* a, double* r, size_t n)
+		{
+			const __m256d sign = _mm256_set1_pd(-0.0);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_pd(r + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+			for (; i < n; i++)
+				r[i] = -a[i];
+		}
+
+		inline void fill(double* r, double val, size_t n)
+		{
+			const __m256d v = _mm256_set1_pd(val);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_pd(r + i, v);
+			for (; i < n; i++)
+				r[i] = val;
+		}
+
+#elif defined(SIMD_KERNELS_SSE2)
+
+#define SIMD_KERNEL_BINARY(name, intrin, op)                                    \
+		inline void name(const double* a, const double* b, double* r, size_t n) \
+		{                                                                       \
+			size_t i = 0;                                                       \
+			for (; i + 2 <= n; i += 2)                                          \
+				_mm_storeu_pd(r + i, intrin(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); \
+			for (; i < n; i++)                                                  \
+				r[i] = a[i] op b[i];                                            \
+		}
+
+		SIMD_KERNEL_BINARY(add, _mm_add_pd, +)
+		SIMD_KERNEL_BINARY(sub, _mm_sub_pd, -)
+		SIMD_KERNEL_BINARY(mul, _mm_mul_pd, *)
+		SIMD_KERNEL_BINARY(div, _mm_div_pd, /)
+#undef SIMD_KERNEL_BINARY
+
+		inline void neg(const double* a, double* r, size_t n)
+		{
+			const __m128d sign = _mm_set1_pd(-0.0);
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_pd(r + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+			for (; i < n; i++)
+				r[i] = -a[i];
+		}
+
+		inline void fill(double* r, double val, size_t n)
+		{
+			const __m128d v = _mm_set1_pd(val);
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_pd(r + i, v);
+			for (; i < n; i++)
+				r[i] = val;
+		}
+
+#endif
+	} // namespace simd
+} // namespace math
+
+#endif // SIMD_KERNELS_H
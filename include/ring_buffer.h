@@ -2,6 +2,10 @@
  * @file ring_buffer.h
  * @author Artem
  * @brief Реализация кольцевого буфера
+ * @note RingBuffer - без синхронизации, RingBuffer<T, N> - то же с размером 2^k на этапе компиляции,
+ * MirroredRingBuffer - то же с непрерывным доступом через конец памяти (Linux),
+ * SpscRingBuffer - один писатель и один читатель в разных потоках без блокировок,
+ * MpmcRingBuffer - любое число писателей и читателей без блокировок
  * @version 0.1
  * @date 2024-08-18
  *
@@ -49,12 +53,31 @@ int main()
 	}
 
 	delete buf;
+
+	ring_buffer::RingBuffer<Type, 8> fixed;	// память внутри объекта, init() не нужен
+	fixed.put(data, 8);
+
+	ring_buffer::RingBuffer<Type, 8, ring_buffer::e_overflow_overwrite> telemetry;
+	telemetry.put(data, 10);	// остаются 2..9, telemetry.dropped() == 2
 	return 0;
 }
 */
 
 #include<stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include <iostream>
 #include <exception>
@@ -70,95 +93,339 @@ namespace ring_buffer
 		std::string _message;
 	};
 
+	static const size_t CACHE_LINE_SIZE = 64;	///< размер строки кэша, разделяющий данные потоков
+
+	/// \brief поведение put() при нехватке места
+	enum e_overflow_t
+	{
+		e_overflow_throw = 0,	///< исключение OverflowException, ничего не записывается
+		e_overflow_reject,		///< код e_err_overflow, ничего не записывается
+		e_overflow_overwrite,	///< удаляются самые старые эл-ты (RingBuffer)
+		e_overflow_block,		///< ожидание места (SpscRingBuffer)
+	};
+
+	/// \brief коды ошибок
+	enum e_code_error
+	{
+		e_success = 0,
+		e_err_overflow,		///< нет места, данные не записаны
+	};
+
+	//! @brief непрерывный участок памяти буфера
+	template<typename _T>
+	struct span
+	{
+		_T* data;
+		uint32_t size;
+	};
+
+	//! @brief участок буфера, разбитый концом памяти на две части (second.size == 0 - без разрыва)
 	template<typename _T>
+	struct span_pair
+	{
+		span<_T> first;
+		span<_T> second;
+
+		inline uint32_t size() const { return first.size + second.size; }
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Память RingBuffer<_T, _N>: встроенный массив, размер - степень 2
+		 * @note позиция сворачивается маской вместо деления.
+		 * Память сырая, эл-ты создаёт и удаляет RingBuffer
+		 */
+		template<typename _T, uint32_t _N>
+		class ring_storage
+		{
+			static_assert(_N != 0 && (_N & (_N - 1)) == 0, "RingBuffer<T, N>: N must be a power of 2");
+
+		public:
+			static constexpr bool mirrored = false;
+
+			ring_storage() : m_raw() {}
+
+			inline void allocate(uint32_t) {}
+			inline void release() {}
+			inline _T* data() { return (_T*)m_raw; }
+			inline const _T* data() const { return (const _T*)m_raw; }
+			static constexpr uint32_t capacity() { return _N; }
+
+			//! @note i < 2 * capacity()
+			static inline uint32_t wrap(uint32_t i) { return i & (_N - 1); }
+
+		private:
+			alignas(_T) uint8_t m_raw[_N * sizeof(_T)];
+		};
+
+		//! @brief Память RingBuffer<_T>: размер задаётся в init(), память сырая
+		template<typename _T>
+		class ring_storage<_T, 0>
+		{
+		public:
+			static constexpr bool mirrored = false;
+
+			ring_storage() : m_buf(nullptr), m_capacity(0) {}
+			~ring_storage() { release(); }
+
+			void allocate(uint32_t N)
+			{
+				release();
+				m_capacity = N;
+				m_buf = (_T*)::operator new(N * sizeof(_T), std::align_val_t(alignof(_T)));
+				memset((void*)m_buf, 0, N * sizeof(_T));
+			}
+
+			void release()
+			{
+				::operator delete(m_buf, std::align_val_t(alignof(_T)));
+				m_buf = nullptr;
+				m_capacity = 0;
+			}
+
+			inline _T* data() { return m_buf; }
+			inline const _T* data() const { return m_buf; }
+			inline uint32_t capacity() const { return m_capacity; }
+
+			//! @note i < 2 * capacity(), без деления
+			inline uint32_t wrap(uint32_t i) const { return i >= m_capacity ? i - m_capacity : i; }
+
+		private:
+			_T* m_buf;
+			uint32_t m_capacity;
+		};
+
+#ifdef __linux__
+		/**
+		 * @brief Память MirroredRingBuffer<_T>: memfd отображён дважды подряд,
+		 * data()[capacity() + i] - тот же эл-т, что data()[i]
+		 * @note любой участок до capacity() эл-в от любой позиции непрерывен, конец памяти не разрывает данные.
+		 * Размер округляется вверх до кратного странице
+		 */
+		template<typename _T>
+		class mirror_storage
+		{
+			// эл-т доступен по двум адресам - только для типов без ссылок на себя
+			static_assert(std::is_trivially_copyable<_T>::value, "MirroredRingBuffer<T>: T must be trivially copyable");
+
+		public:
+			static constexpr bool mirrored = true;
+
+			mirror_storage() : m_buf(nullptr), m_capacity(0) {}
+			~mirror_storage() { release(); }
+
+			void allocate(uint32_t N)
+			{
+				release();
+
+				// capacity * sizeof(_T) кратно странице, иначе вторая копия сдвинута
+				size_t page = (size_t)sysconf(_SC_PAGESIZE);
+				size_t gcd = page;
+				for (size_t b = sizeof(_T); b; )
+				{
+					size_t t = gcd % b;
+					gcd = b;
+					b = t;
+				}
+				size_t step = page / gcd;	// эл-в в наименьшем кратном странице участке
+				size_t capacity = (N + step - 1) / step * step;
+				if (!capacity)
+				{
+					capacity = step;
+				}
+				size_t bytes = capacity * sizeof(_T);
+
+				int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+				if (fd < 0)
+				{
+					throw std::system_error(errno, std::generic_category(), "memfd_create");
+				}
+				if (ftruncate(fd, bytes) < 0)
+				{
+					int err = errno;
+					close(fd);
+					throw std::system_error(err, std::generic_category(), "ftruncate");
+				}
+
+				// резерв адресов под две копии, затем обе копии поверх резерва
+				uint8_t* base = (uint8_t*)mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (base == MAP_FAILED
+					|| mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+					|| mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+				{
+					int err = errno;
+					if (base != MAP_FAILED)
+					{
+						munmap(base, 2 * bytes);
+					}
+					close(fd);
+					throw std::system_error(err, std::generic_category(), "mmap");
+				}
+				close(fd);	// отображения держат память
+
+				m_buf = (_T*)base;
+				m_capacity = (uint32_t)capacity;
+			}
+
+			void release()
+			{
+				if (m_buf)
+				{
+					munmap(m_buf, 2 * (size_t)m_capacity * sizeof(_T));
+				}
+				m_buf = nullptr;
+				m_capacity = 0;
+			}
+
+			inline _T* data() { return m_buf; }
+			inline const _T* data() const { return m_buf; }
+			inline uint32_t capacity() const { return m_capacity; }
+
+			//! @note i < 2 * capacity(), без деления
+			inline uint32_t wrap(uint32_t i) const { return i >= m_capacity ? i - m_capacity : i; }
+
+		private:
+			_T* m_buf;
+			uint32_t m_capacity;
+		};
+#endif
+	}
+
+	/**
+	 * @brief Кольцевой буфер без синхронизации
+	 * @tparam _N размер буфера - степень 2, память внутри объекта (подходит для стека и встраиваемых систем);
+	 * 0 - размер задаётся init(), память в куче
+	 * @tparam _Overflow поведение put() при нехватке места: e_overflow_throw, e_overflow_reject или
+	 * e_overflow_overwrite (телеметрия: новые данные вытесняют старые). Потерянные эл-ты считает dropped()
+	 * @tparam _Storage память буфера, см. MirroredRingBuffer
+	 * @note _T может быть любым перемещаемым типом (std::string, std::vector): эл-ты создаются в буфере
+	 * при put()/emplace() и удаляются при pop()/erase()/clear(). Для тривиально копируемых _T - memcpy
+	 */
+	template<typename _T, uint32_t _N = 0, e_overflow_t _Overflow = e_overflow_throw, typename _Storage = detail::ring_storage<_T, _N>>
 	class RingBuffer
 	{
+		static_assert(_Overflow != e_overflow_block, "RingBuffer: no other thread frees space, use SpscRingBuffer");
+
 	public:
 
-		RingBuffer() :m_capacity(0), m_size(0), w_ptr(0), r_ptr(0), m_buf(nullptr) {}
+		RingBuffer() : m_size(0), r_ptr(0), w_ptr(0), m_dropped(0) {}
 		~RingBuffer() { clear(); }
 
 		/**
 		 * @brief Инициализация буфера, Выделение памяти
 		 *
-		 * @param N размер буфера
+		 * @param N размер буфера (для RingBuffer<_T, _N> не используется)
 		 */
-		void init(uint32_t N)
+		void init(uint32_t N = _N)
 		{
-			if (m_capacity)
-			{
-				clear();
-			}
-
+			erase(m_size);
+			m_store.allocate(N);
 			w_ptr = r_ptr = m_size = 0;
-			m_capacity = N;
-			m_buf = new _T[N];
-			memset(m_buf, 0, N * sizeof(_T));
 		}
 
 		//! @brief очистка памяти буфера
 		void clear()
 		{
-			if (m_buf != nullptr)
-			{
-				delete[] m_buf;
-				m_buf = nullptr;
-				m_capacity = w_ptr = r_ptr = m_size = 0;
-			}
+			erase(m_size);
+			m_store.release();
+			w_ptr = r_ptr = m_size = 0;
+			m_dropped = 0;
 		}
 
+		inline uint32_t capacity() const { return m_store.capacity(); }
+
+		//! @brief число эл-в, не попавших в буфер или вытесненных из него при переполнении
+		inline uint64_t dropped() const { return m_dropped; }
+
 		/**
 		 * @brief Поместить в буфер новые данные
 		 *
 		 * @param[in] data данные
 		 * @param[in] in_size размер входного массива
-		 * @return int - код ошибки
+		 * @return int - код ошибки ::e_code_error
 		 */
 		int put(const _T* data, uint32_t in_size)
 		{
 			if (in_size == 0)
 			{
-				return 0;
+				return e_success;
 			}
 
-			int32_t N = m_capacity - m_size;	//максиальный размер свободной части буфера
-
-			if (in_size > N)
+			if constexpr (_Overflow == e_overflow_overwrite)
 			{
-				throw OverflowException("Buffer overflow!!!");
+				// в буфер попадают только последние capacity() эл-в
+				if (in_size > capacity())
+				{
+					m_dropped += in_size - capacity();
+					data += in_size - capacity();
+					in_size = capacity();
+				}
+			}
+			if (in_size > capacity() - m_size && !overflow(in_size))
+			{
+				return e_err_overflow;
+			}
+			_T* buf = m_store.data();
+			if constexpr (!trivial)
+			{
+				// по одному: при исключении в конструкторе созданные эл-ты остаются в буфере
+				for (uint32_t k = 0; k < in_size; k++)
+				{
+					new (buf + w_ptr) _T(data[k]);
+					w_ptr = m_store.wrap(w_ptr + 1);
+					m_size++;
+				}
 			}
 			else
 			{
-				if (w_ptr + in_size <= m_capacity)
+				if (_Storage::mirrored || w_ptr + in_size <= capacity())
 				{
-					memcpy(m_buf + w_ptr, data, in_size * sizeof(_T));
+					memcpy(buf + w_ptr, data, in_size * sizeof(_T));
 				}
 				else
 				{
-					uint32_t n = m_capacity - w_ptr;
-					memcpy(m_buf + w_ptr, data, n * sizeof(_T));
-					memcpy(m_buf, data + n, (in_size - n) * sizeof(_T));
+					uint32_t n = capacity() - w_ptr;
+					memcpy(buf + w_ptr, data, n * sizeof(_T));
+					memcpy(buf, data + n, (in_size - n) * sizeof(_T));
 				}
-				w_ptr = (w_ptr + in_size) % m_capacity;
+				w_ptr = m_store.wrap(w_ptr + in_size);
 				m_size += in_size;
 			}
-			return 0;
+			return e_success;
 		}
 
 		/**
 		 * @brief Поместить в буфер один элемент
 		 * @param[in] val данные
+		 * @return int - код ошибки ::e_code_error
 		 */
-		int put(const _T val)
+		int put(const _T& val)
+		{
+			return emplace(val);
+		}
+
+		//! @brief Поместить в буфер один элемент перемещением
+		int put(_T&& val)
+		{
+			return emplace(std::move(val));
+		}
+
+		/**
+		 * @brief Создать элемент прямо в буфере
+		 * @param[in] args аргументы конструктора _T
+		 */
+		template<typename... _Args>
+		int emplace(_Args&&... args)
 		{
-			if (m_capacity == m_size)
+			if (capacity() == m_size && !overflow(1))
 			{
-				throw OverflowException("Buffer overflow!!!");
+				return e_err_overflow;
 			}
-			m_buf[w_ptr] = val;
-			w_ptr = (w_ptr + 1) % m_capacity;
+			new (m_store.data() + w_ptr) _T(std::forward<_Args>(args)...);
+			w_ptr = m_store.wrap(w_ptr + 1);
 			m_size++;
-			return 0;
+			return e_success;
 		}
 
 		/**
@@ -181,15 +448,23 @@ namespace ring_buffer
 				out_size = m_size;
 			}
 
-			if (r_ptr + out_size <= m_capacity)
+			const _T* buf = m_store.data();
+			if constexpr (!trivial)
+			{
+				for (uint32_t k = 0; k < out_size; k++)
+				{
+					data[k] = buf[m_store.wrap(r_ptr + k)];
+				}
+			}
+			else if (_Storage::mirrored || r_ptr + out_size <= capacity())
 			{
-				memcpy(data, m_buf + r_ptr, out_size * sizeof(_T));
+				memcpy(data, buf + r_ptr, out_size * sizeof(_T));
 			}
 			else
 			{
-				int n = m_capacity - r_ptr;
-				memcpy(data, m_buf + r_ptr, n * sizeof(_T));
-				memcpy(data + n, m_buf, (out_size - n) * sizeof(_T));
+				int n = capacity() - r_ptr;
+				memcpy(data, buf + r_ptr, n * sizeof(_T));
+				memcpy(data + n, buf, (out_size - n) * sizeof(_T));
 			}
 			return out_size;
 		}
@@ -205,7 +480,7 @@ namespace ring_buffer
 			{
 				return 0;
 			}
-			*val = m_buf[r_ptr];
+			*val = m_store.data()[r_ptr];
 			return 1;
 		}
 
@@ -219,29 +494,22 @@ namespace ring_buffer
 		 */
 		int pop(_T* data, uint32_t out_size)
 		{
-			if (m_size == 0)
-			{
-				return 0;
-			}
-
-			if (m_size < out_size)
+			if constexpr (!trivial)
 			{
-				out_size = m_size;
-			}
-
-			if (r_ptr + out_size <= m_capacity)
-			{
-				memcpy(data, m_buf + r_ptr, out_size * sizeof(_T));
+				uint32_t n = m_size < out_size ? m_size : out_size;
+				for (uint32_t k = 0; k < n; k++)
+				{
+					pop(data + k);
+				}
+				return n;
 			}
 			else
 			{
-				int n = m_capacity - r_ptr;
-				memcpy(data, m_buf + r_ptr, n * sizeof(_T));
-				memcpy(data + n, m_buf, (out_size - n) * sizeof(_T));
+				out_size = get(data, out_size);
+				r_ptr = m_store.wrap(r_ptr + out_size);
+				m_size -= out_size;
+				return out_size;
 			}
-			r_ptr = (r_ptr + out_size) % m_capacity;
-			m_size -= out_size;
-			return out_size;
 		}
 
 		/**
@@ -249,45 +517,105 @@ namespace ring_buffer
 		 * @param[out] val данные
 		 * @return число забранных элементов
 		 */
-		int pop(const _T* val)
+		int pop(_T* val)
 		{
 			if (m_size == 0)
 			{
 				return 0;
 			}
 
-			*val = m_buf[r_ptr];
-			r_ptr = (r_ptr + 1) % m_capacity;
+			_T& item = m_store.data()[r_ptr];
+			*val = std::move(item);
+			item.~_T();
+			r_ptr = m_store.wrap(r_ptr + 1);
 			m_size--;
 			return 1;
 		}
 
+		/**
+		 * @brief Место для записи без копирования: данные пишутся прямо в буфер, затем commit_write()
+		 * @note Если свободного места меньше n, возвращается всё свободное место
+		 *
+		 * @param[in] n требуемое число эл-в
+		 * @return участки буфера, до и после конца памяти
+		 */
+		span_pair<_T> reserve_write(uint32_t n)
+		{
+			static_assert(trivial, "reserve_write: T must be trivially copyable");
+
+			uint32_t N = capacity() - m_size;
+			if (n > N)
+			{
+				n = N;
+			}
+			return split(m_store.data(), w_ptr, n);
+		}
+
+		/**
+		 * @brief Добавить в буфер n эл-в, записанных в участки reserve_write()
+		 * @param[in] n число записанных эл-в, не больше зарезервированного
+		 */
+		void commit_write(uint32_t n)
+		{
+			static_assert(trivial, "commit_write: T must be trivially copyable");
+
+			if (n > capacity() - m_size)
+			{
+				throw OverflowException("Buffer overflow!!!");
+			}
+			w_ptr = m_store.wrap(w_ptr + n);
+			m_size += n;
+		}
+
+		/**
+		 * @brief Данные буфера без копирования и без удаления, удаление - consume()
+		 * @note Если в буфере меньше n эл-в, возвращаются все
+		 *
+		 * @param[in] n максимальное число эл-в
+		 * @return участки буфера, до и после конца памяти
+		 */
+		span_pair<const _T> peek_read(uint32_t n = UINT32_MAX) const
+		{
+			if (n > m_size)
+			{
+				n = m_size;
+			}
+			return split(m_store.data(), r_ptr, n);
+		}
+
+		/**
+		 * @brief Удалить из буфера n прочитанных через peek_read() эл-в
+		 * @return число удалённых эл-в
+		 */
+		uint32_t consume(uint32_t n)
+		{
+			if (n > m_size)
+			{
+				n = m_size;
+			}
+			erase(n);
+			return n;
+		}
+
 		/**
 		 * @brief Перенести данные из одного буфера в другой (с удалением из первого)
 		 * @note Если размер источника меньше запрошенного размера, будет скопирован буфер целиком
 		 *
 		 * @param[inout] src входной буфер
-		 * @param[in] size число элементов для копирования
+		 * @param[in] size число элементов для копирования, не больше capacity()
 		 * @return число скопированных элементов
 		 */
 		int copy(RingBuffer* src, uint32_t size)
 		{
-			if (!size)
+			span_pair<const _T> r = src->peek_read(size < capacity() ? size : capacity());
+			if (r.size() > capacity() - m_size && !overflow(r.size(), true))
 			{
 				return 0;
 			}
-
-			int N = src->size();
-			if (size > N)
-			{
-				size = N;
-			}
-
-			int n = src->m_capacity - src->r_pt;
-			this->put(src->m_buf + src->r_ptr, n);
-			this->put(src->m_buf, size - n);
-			src->erase(size);
-			return size;
+			put(r.first.data, r.first.size);
+			put(r.second.data, r.second.size);
+			src->erase(r.size());
+			return r.size();
 		}
 
 		//! @brief удалить из буфера N элментов
@@ -297,7 +625,14 @@ namespace ring_buffer
 			{
 				N = m_size;
 			}
-			r_ptr = (r_ptr + N) % m_capacity;
+			if constexpr (!std::is_trivially_destructible<_T>::value)
+			{
+				for (uint32_t k = 0; k < N; k++)
+				{
+					m_store.data()[m_store.wrap(r_ptr + k)].~_T();
+				}
+			}
+			r_ptr = m_store.wrap(r_ptr + N);
 			m_size -= N;
 		}
 
@@ -310,21 +645,736 @@ namespace ring_buffer
 		void print_hex(const char* msg="") const
 		{
 			printf("%s", msg);						
-			for (uint32_t i = 0; i < m_capacity * sizeof(_T); i++)
+			for (uint32_t i = 0; i < capacity() * sizeof(_T); i++)
 			{
-				printf("0x%02x ", ((uint8_t*)m_buf)[i]);
+				printf("0x%02x ", ((const uint8_t*)m_store.data())[i]);
 			}
 			printf("\n");
 		}
 
 	private:
-		RingBuffer(const RingBuffer<_T>&); // No copy constructor
+		RingBuffer(const RingBuffer&); // No copy constructor
 
-		_T* m_buf;				///< данные
+		/**
+		 * @brief Нет места под n эл-в: действие по политике _Overflow
+		 * @param kept эл-ты остаются у вызывающего (copy()): не потеряны, в dropped() не считаются
+		 * @return true - место освобождено (e_overflow_overwrite), false - эл-ты отброшены
+		 */
+		bool overflow(uint32_t n, bool kept = false)
+		{
+			if constexpr (_Overflow == e_overflow_overwrite)
+			{
+				if (n <= capacity())
+				{
+					uint32_t old = n - (capacity() - m_size);
+					erase(old);
+					m_dropped += old;
+					return true;
+				}
+			}
+			if (!kept)
+			{
+				m_dropped += n;
+			}
+			if constexpr (_Overflow == e_overflow_throw)
+			{
+				throw OverflowException("Buffer overflow!!!");
+			}
+			return false;
+		}
+
+		static constexpr bool trivial = std::is_trivially_copyable<_T>::value;	///< копирование memcpy
+
+		//! @brief n эл-в начиная с pos, с учётом конца памяти
+		template<typename _P>
+		span_pair<_P> split(_P* buf, uint32_t pos, uint32_t n) const
+		{
+			uint32_t n1 = capacity() - pos;
+			if (_Storage::mirrored || n1 > n)
+			{
+				n1 = n;
+			}
+			span_pair<_P> res = { { buf + pos, n1 }, { buf, n - n1 } };
+			return res;
+		}
+
+		_Storage m_store;		///< данные
 		uint32_t m_size;		///< число эл-в в буфере
-		uint32_t m_capacity;	///< общий размер выделенной памяти под буфер
 		uint32_t r_ptr;			///< указатель на место чтения
 		uint32_t w_ptr;			///< указатель на место записи
+		uint64_t m_dropped;		///< потеряно эл-в при переполнении
+	};
+
+#ifdef __linux__
+	/**
+	 * @brief RingBuffer с зеркальным отображением памяти (Linux): put/get/pop - одно копирование,
+	 * reserve_write()/peek_read() - всегда один непрерывный участок, кадр на конце памяти разбирается на месте
+	 * @note ёмкость после init() - capacity(), может быть больше запрошенной
+	 */
+	template<typename _T, e_overflow_t _Overflow = e_overflow_throw>
+	using MirroredRingBuffer = RingBuffer<_T, 0, _Overflow, detail::mirror_storage<_T>>;
+#endif
+
+	/**
+	 * @brief Кольцевой буфер для одного потока-писателя и одного потока-читателя
+	 * @note put() вызывает только писатель, get()/pop()/erase() - только читатель, init()/clear() - без других вызовов.
+	 * Индексы записи и чтения - атомарные, в разных строках кэша; каждая сторона хранит копию индекса другой стороны
+	 * и перечитывает его только при нехватке места/данных. Операции не блокируются и не ждут друг друга.
+	 * Ожидание без опроса (только e_overflow_block) - wait_for_data()/wait_for_space(), pop_wait()/put_wait():
+	 * ждущая сторона заявляет нужное число эл-в, другая будит её один раз, когда оно набралось. Проверка заявки
+	 * стоит put()/pop() барьера памяти, поэтому при других политиках её нет совсем
+	 * @tparam _T тривиально копируемый тип: эл-ты копируются memcpy без конструкторов
+	 * @tparam _Overflow поведение put() при нехватке места: e_overflow_throw, e_overflow_reject или e_overflow_block.
+	 * Вытеснения старых эл-в нет: индекс чтения меняет только читатель
+	 *
+	 * Example:
+	 *	ring_buffer::SpscRingBuffer<int> buf;
+	 *	buf.init(1024);
+	 *	std::thread reader([&]() { int v; for (int n = 0; n < 100; ) { int k = buf.pop(&v); n += k; if (!k) std::this_thread::yield(); } });
+	 *	for (int i = 0; i < 100; ) { if (buf.size() < 1024) buf.put(i++); else std::this_thread::yield(); }
+	 *	reader.join();
+	 */
+	template<typename _T, e_overflow_t _Overflow = e_overflow_throw>
+	class SpscRingBuffer
+	{
+		static_assert(std::is_trivially_copyable<_T>::value, "SpscRingBuffer<T>: T must be trivially copyable");
+		static_assert(_Overflow != e_overflow_overwrite, "SpscRingBuffer: the writer cannot drop unread elements");
+
+		static constexpr bool waitable = _Overflow == e_overflow_block;	///< есть ожидание без опроса
+
+	public:
+
+		SpscRingBuffer() : m_buf(nullptr), m_slots(0), m_write(0), m_read_cache(0), m_dropped(0), m_read(0), m_write_cache(0),
+			m_read_need(0), m_write_need(0) {}
+		~SpscRingBuffer() { clear(); }
+
+		/**
+		 * @brief Инициализация буфера, Выделение памяти
+		 *
+		 * @param N размер буфера
+		 */
+		void init(uint32_t N)
+		{
+			clear();
+			m_slots = N + 1;	//одна ячейка всегда свободна: полный буфер отличается от пустого
+			m_buf = new _T[m_slots];
+			memset(m_buf, 0, m_slots * sizeof(_T));
+		}
+
+		//! @brief очистка памяти буфера
+		void clear()
+		{
+			delete[] m_buf;
+			m_buf = nullptr;
+			m_slots = 0;
+			m_write.store(0, std::memory_order_relaxed);
+			m_read.store(0, std::memory_order_relaxed);
+			m_read_cache = m_write_cache = 0;
+			m_dropped.store(0, std::memory_order_relaxed);
+			m_read_need.store(0, std::memory_order_relaxed);
+			m_write_need.store(0, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Поместить в буфер новые данные (писатель)
+		 *
+		 * @param[in] data данные
+		 * @param[in] in_size размер входного массива
+		 * @return int - код ошибки ::e_code_error
+		 */
+		int put(const _T* data, uint32_t in_size)
+		{
+			if (in_size == 0)
+			{
+				return e_success;
+			}
+
+			const uint32_t w = m_write.load(std::memory_order_relaxed);
+			if (free_space(w, m_read_cache) < in_size)
+			{
+				m_read_cache = m_read.load(std::memory_order_acquire);
+				if (free_space(w, m_read_cache) < in_size && !overflow(in_size))
+				{
+					return e_err_overflow;
+				}
+			}
+
+			if (w + in_size <= m_slots)
+			{
+				memcpy(m_buf + w, data, in_size * sizeof(_T));
+			}
+			else
+			{
+				uint32_t n = m_slots - w;
+				memcpy(m_buf + w, data, n * sizeof(_T));
+				memcpy(m_buf, data + n, (in_size - n) * sizeof(_T));
+			}
+			m_write.store(wrap(w + in_size), std::memory_order_release);
+			notify_reader(wrap(w + in_size));
+			return e_success;
+		}
+
+		/**
+		 * @brief Поместить в буфер один элемент (писатель)
+		 * @param[in] val данные
+		 * @return int - код ошибки ::e_code_error
+		 */
+		int put(const _T val)
+		{
+			const uint32_t w = m_write.load(std::memory_order_relaxed);
+			const uint32_t next = wrap(w + 1);
+			if (next == m_read_cache)
+			{
+				m_read_cache = m_read.load(std::memory_order_acquire);
+				if (next == m_read_cache && !overflow(1))
+				{
+					return e_err_overflow;
+				}
+			}
+			m_buf[w] = val;
+			m_write.store(next, std::memory_order_release);
+			notify_reader(next);
+			return e_success;
+		}
+
+		/**
+		 * @brief Забрать данные из буфера, без удаления их из буфера (читатель)
+		 * @note Если в буфере недостаточно элементов будет забрано макс. возможное кол-во
+		 *
+		 * @param[out] data выходной массив
+		 * @param[in] out_size максимальное число забираемых эл-в
+		 * @return число реально забранных элементов
+		 */
+		int get(_T* data, uint32_t out_size) const
+		{
+			const uint32_t r = m_read.load(std::memory_order_relaxed);
+			out_size = available(r, out_size);
+			if (out_size == 0)
+			{
+				return 0;
+			}
+
+			if (r + out_size <= m_slots)
+			{
+				memcpy(data, m_buf + r, out_size * sizeof(_T));
+			}
+			else
+			{
+				uint32_t n = m_slots - r;
+				memcpy(data, m_buf + r, n * sizeof(_T));
+				memcpy(data + n, m_buf, (out_size - n) * sizeof(_T));
+			}
+			return out_size;
+		}
+
+		/**
+		 * @brief Забрать из буфера один элемент (без удаления, читатель)
+		 * @param[out] val данные
+		 * @return число забранных элементов
+		 */
+		int get(_T* val) const
+		{
+			const uint32_t r = m_read.load(std::memory_order_relaxed);
+			if (available(r, 1) == 0)
+			{
+				return 0;
+			}
+			*val = m_buf[r];
+			return 1;
+		}
+
+		/**
+		 * @brief Забрать данные из буфера и удалить их из буфера (читатель)
+		 * @note Если в буфере недостаточно элементов будет забрано макс. возможное кол-во
+		 *
+		 * @param[out] data выходной массив
+		 * @param[in] out_size максимальное число забираемых эл-в
+		 * @return число реально забранных элементов
+		 */
+		int pop(_T* data, uint32_t out_size)
+		{
+			out_size = get(data, out_size);
+			if (out_size)
+			{
+				const uint32_t r = wrap(m_read.load(std::memory_order_relaxed) + out_size);
+				m_read.store(r, std::memory_order_release);
+				notify_writer(r);
+			}
+			return out_size;
+		}
+
+		/**
+		 * @brief Забрать из буфера один элемент (и удалить из буфера, читатель)
+		 * @param[out] val данные
+		 * @return число забранных элементов
+		 */
+		int pop(_T* val)
+		{
+			const uint32_t r = m_read.load(std::memory_order_relaxed);
+			if (available(r, 1) == 0)
+			{
+				return 0;
+			}
+			*val = m_buf[r];
+			m_read.store(wrap(r + 1), std::memory_order_release);
+			notify_writer(wrap(r + 1));
+			return 1;
+		}
+
+		//! @brief удалить из буфера N элментов (читатель)
+		void erase(uint32_t N)
+		{
+			const uint32_t r = m_read.load(std::memory_order_relaxed);
+			N = available(r, N);
+			m_read.store(wrap(r + N), std::memory_order_release);
+			notify_writer(wrap(r + N));
+		}
+
+		//! @brief число эл-в в буфере (для другой стороны - на момент вызова)
+		inline uint32_t size() const
+		{
+			return used(m_write.load(std::memory_order_acquire), m_read.load(std::memory_order_acquire));
+		}
+
+		//! @brief число эл-в, не попавших в буфер при переполнении
+		inline uint64_t dropped() const
+		{
+			return m_dropped.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Ждать, пока в буфере будет не меньше n эл-в (читатель)
+		 *
+		 * @param n число эл-в, не больше размера буфера
+		 * @param timeout_ms таймаут, < 0 - без таймаута
+		 * @return false - таймаут или буфер не инициализирован
+		 */
+		bool wait_for_data(uint32_t n, int timeout_ms = -1)
+		{
+			static_assert(waitable, "SpscRingBuffer::wait_for_data: requires e_overflow_block");
+			if (m_slots == 0)
+			{
+				return false;	// до init() ждать нечего
+			}
+			if (n > m_slots - 1)
+			{
+				n = m_slots - 1;
+			}
+			const uint32_t r = m_read.load(std::memory_order_relaxed);
+			if (available(r, n) >= n)
+			{
+				return true;
+			}
+			return wait(m_data_cv, m_read_need, n, timeout_ms, [&]() { return available(r, n) >= n; });
+		}
+
+		/**
+		 * @brief Ждать, пока в буфере будет не меньше n свободных мест (писатель)
+		 *
+		 * @param n число мест, не больше размера буфера
+		 * @param timeout_ms таймаут, < 0 - без таймаута
+		 * @return false - таймаут или буфер не инициализирован
+		 */
+		bool wait_for_space(uint32_t n, int timeout_ms = -1)
+		{
+			static_assert(waitable, "SpscRingBuffer::wait_for_space: requires e_overflow_block");
+			if (m_slots == 0)
+			{
+				return false;	// до init() ждать нечего
+			}
+			if (n > m_slots - 1)
+			{
+				n = m_slots - 1;
+			}
+			const uint32_t w = m_write.load(std::memory_order_relaxed);
+			if (free_space(w, m_read_cache) >= n)
+			{
+				return true;
+			}
+			return wait(m_space_cv, m_write_need, n, timeout_ms, [&]()
+				{
+					m_read_cache = m_read.load(std::memory_order_acquire);
+					return free_space(w, m_read_cache) >= n;
+				});
+		}
+
+		/**
+		 * @brief Забрать данные, дождавшись не меньше min эл-в (читатель)
+		 * @note По таймауту забирается сколько есть
+		 *
+		 * @param[out] data выходной массив
+		 * @param[in] out_size максимальное число забираемых эл-в
+		 * @param[in] timeout_ms таймаут, < 0 - без таймаута
+		 * @param[in] min сколько эл-в ждать, не больше out_size
+		 * @return число реально забранных элементов
+		 */
+		int pop_wait(_T* data, uint32_t out_size, int timeout_ms = -1, uint32_t min = 1)
+		{
+			static_assert(waitable, "SpscRingBuffer::pop_wait: requires e_overflow_block");
+			wait_for_data(min < out_size ? min : out_size, timeout_ms);
+			return pop(data, out_size);
+		}
+
+		/**
+		 * @brief Поместить в буфер данные, дождавшись места для всех (писатель)
+		 *
+		 * @param[in] data данные
+		 * @param[in] in_size размер входного массива, не больше размера буфера
+		 * @param[in] timeout_ms таймаут, < 0 - без таймаута
+		 * @return false - таймаут, данные не помещены
+		 */
+		bool put_wait(const _T* data, uint32_t in_size, int timeout_ms = -1)
+		{
+			static_assert(waitable, "SpscRingBuffer::put_wait: requires e_overflow_block");
+			if (!wait_for_space(in_size, timeout_ms))
+			{
+				return false;
+			}
+			put(data, in_size);
+			return true;
+		}
+
+	private:
+		SpscRingBuffer(const SpscRingBuffer&); // No copy constructor
+
+		/**
+		 * @brief Нет места под n эл-в: действие по политике _Overflow (писатель)
+		 * @return true - место появилось (e_overflow_block), false - эл-ты отброшены
+		 */
+		bool overflow(uint32_t n)
+		{
+			if constexpr (_Overflow == e_overflow_block)
+			{
+				if (n <= m_slots - 1)
+				{
+					return wait_for_space(n);
+				}
+			}
+			// изменяет только писатель: без атомарного сложения
+			m_dropped.store(m_dropped.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+			if constexpr (_Overflow != e_overflow_reject)
+			{
+				throw OverflowException("Buffer overflow!!!");
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Сон до выполнения ready()
+		 * @param need заявка для другой стороны: сколько эл-в (мест) ждём
+		 */
+		template<typename _Ready>
+		bool wait(std::condition_variable& cv, std::atomic<uint32_t>& need, uint32_t n, int timeout_ms, _Ready ready)
+		{
+			std::unique_lock<std::mutex> lock(m_wait_lock);
+			need.store(n, std::memory_order_relaxed);
+			// пара к fence в notify_*(): либо другая сторона видит заявку, либо ready() видит её индекс
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			bool ok = true;
+			if (timeout_ms < 0)
+			{
+				cv.wait(lock, ready);
+			}
+			else
+			{
+				ok = cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+			}
+			need.store(0, std::memory_order_relaxed);
+			return ok;
+		}
+
+		//! @brief разбудить читателя, если набралось заявленное им число эл-в (писатель, w - новый индекс)
+		inline void notify_reader(uint32_t w)
+		{
+			if constexpr (waitable)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const uint32_t need = m_read_need.load(std::memory_order_relaxed);
+				if (need && used(w, m_read.load(std::memory_order_relaxed)) >= need)
+				{
+					wake(m_data_cv);
+				}
+			}
+		}
+
+		//! @brief разбудить писателя, если освободилось заявленное им число мест (читатель, r - новый индекс)
+		inline void notify_writer(uint32_t r)
+		{
+			if constexpr (waitable)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const uint32_t need = m_write_need.load(std::memory_order_relaxed);
+				if (need && free_space(m_write.load(std::memory_order_relaxed), r) >= need)
+				{
+					wake(m_space_cv);
+				}
+			}
+		}
+
+		void wake(std::condition_variable& cv)
+		{
+			// захват замка: ждущий либо ещё не проверил условие, либо уже спит в wait()
+			{
+				std::lock_guard<std::mutex> lock(m_wait_lock);
+			}
+			cv.notify_one();
+		}
+
+		//! @note i < 2 * m_slots, без деления
+		inline uint32_t wrap(uint32_t i) const { return i >= m_slots ? i - m_slots : i; }
+		inline uint32_t used(uint32_t w, uint32_t r) const { return w >= r ? w - r : w + m_slots - r; }
+		inline uint32_t free_space(uint32_t w, uint32_t r) const { return m_slots - 1 - used(w, r); }
+
+		//! @brief min(n, число эл-в для чтения), индекс записи перечитывается только при нехватке
+		inline uint32_t available(uint32_t r, uint32_t n) const
+		{
+			uint32_t count = used(m_write_cache, r);
+			if (count < n)
+			{
+				m_write_cache = m_write.load(std::memory_order_acquire);
+				count = used(m_write_cache, r);
+			}
+			return count < n ? count : n;
+		}
+
+		_T* m_buf;				///< данные
+		uint32_t m_slots;		///< число ячеек: размер буфера + 1
+
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_write;	///< место записи, изменяет писатель
+		uint32_t m_read_cache;								///< копия m_read у писателя
+		std::atomic<uint64_t> m_dropped;					///< потеряно эл-в, изменяет писатель
+
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_read;	///< место чтения, изменяет читатель
+		mutable uint32_t m_write_cache;						///< копия m_write у читателя
+
+		// ожидание, меняется только в начале и в конце ожидания
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_read_need;	///< читатель ждёт столько эл-в, 0 - не ждёт
+		std::atomic<uint32_t> m_write_need;					///< писатель ждёт столько мест, 0 - не ждёт
+		std::mutex m_wait_lock;
+		std::condition_variable m_data_cv;					///< ждёт читатель
+		std::condition_variable m_space_cv;					///< ждёт писатель
+	};
+
+	/**
+	 * @brief Ограниченная очередь для нескольких писателей и нескольких читателей (алгоритм Вьюкова)
+	 * @note У каждой ячейки номер последовательности: ячейка свободна для записи позиции pos, если seq == pos,
+	 * и готова к чтению, если seq == pos + 1. Писатели и читатели занимают позиции CAS общего индекса,
+	 * пакет - несколько подряд идущих позиций одним CAS. Размер округляется вверх до степени 2.
+	 * Просмотра без удаления (get()) нет: при нескольких читателях просмотренный эл-т может забрать другой
+	 *
+	 * Example:
+	 *	ring_buffer::MpmcRingBuffer<int> queue;
+	 *	queue.init(1024);
+	 *	// писатели:
+	 *	if (!queue.try_put(42)) { ... }		// или put(42) с OverflowException
+	 *	// читатели:
+	 *	int batch[16];
+	 *	int n = queue.pop(batch, 16);
+	 */
+	template<typename _T>
+	class MpmcRingBuffer
+	{
+	public:
+
+		MpmcRingBuffer() : m_cells(nullptr), m_mask(0), m_write(0), m_read(0) {}
+		~MpmcRingBuffer() { clear(); }
+
+		/**
+		 * @brief Инициализация буфера, Выделение памяти (без других вызовов)
+		 *
+		 * @param N размер буфера, округляется вверх до степени 2
+		 */
+		void init(uint32_t N)
+		{
+			clear();
+			uint32_t capacity = 1;
+			while (capacity < N)
+			{
+				capacity <<= 1;
+			}
+
+			m_cells = new cell[capacity];
+			m_mask = capacity - 1;
+			for (uint32_t i = 0; i < capacity; i++)
+			{
+				m_cells[i].seq.store(i, std::memory_order_relaxed);
+			}
+			m_write.store(0, std::memory_order_relaxed);
+			m_read.store(0, std::memory_order_relaxed);
+		}
+
+		//! @brief очистка памяти буфера (без других вызовов)
+		void clear()
+		{
+			delete[] m_cells;
+			m_cells = nullptr;
+			m_mask = 0;
+		}
+
+		inline uint32_t capacity() const { return m_cells ? m_mask + 1 : 0; }
+
+		/**
+		 * @brief Поместить в буфер все данные или ничего
+		 *
+		 * @param[in] data данные
+		 * @param[in] in_size размер входного массива
+		 * @return false - нет места для in_size эл-в
+		 */
+		bool try_put(const _T* data, uint32_t in_size)
+		{
+			if (in_size == 0)
+			{
+				return true;
+			}
+			if (in_size > capacity())
+			{
+				return false;
+			}
+
+			uint32_t pos = m_write.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				int32_t diff = 0;
+				uint32_t k = 0;
+				for (; k < in_size; k++)
+				{
+					diff = (int32_t)(at(pos + k).seq.load(std::memory_order_acquire) - (pos + k));
+					if (diff != 0)
+					{
+						break;
+					}
+				}
+
+				if (k == in_size)
+				{
+					if (m_write.compare_exchange_weak(pos, pos + in_size, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)	//ячейку ещё не освободил читатель предыдущего круга
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_write.load(std::memory_order_relaxed);
+				}
+			}
+
+			for (uint32_t k = 0; k < in_size; k++)
+			{
+				cell& c = at(pos + k);
+				c.data = data[k];
+				c.seq.store(pos + k + 1, std::memory_order_release);
+			}
+			return true;
+		}
+
+		inline bool try_put(const _T val) { return try_put(&val, 1); }
+
+		/**
+		 * @brief Поместить в буфер новые данные
+		 * @note при нехватке места ничего не записывается, исключение OverflowException
+		 * @return int - код ошибки
+		 */
+		int put(const _T* data, uint32_t in_size)
+		{
+			if (!try_put(data, in_size))
+			{
+				throw OverflowException("Buffer overflow!!!");
+			}
+			return 0;
+		}
+
+		inline int put(const _T val) { return put(&val, 1); }
+
+		/**
+		 * @brief Забрать данные из буфера и удалить их из буфера
+		 * @note Если в буфере недостаточно элементов будет забрано макс. возможное кол-во
+		 *
+		 * @param[out] data выходной массив
+		 * @param[in] out_size максимальное число забираемых эл-в
+		 * @return число реально забранных элементов
+		 */
+		int pop(_T* data, uint32_t out_size)
+		{
+			if (out_size == 0 || !m_cells)
+			{
+				return 0;
+			}
+
+			uint32_t pos = m_read.load(std::memory_order_relaxed);
+			uint32_t k;
+			for (;;)
+			{
+				int32_t diff = 0;
+				for (k = 0; k < out_size; k++)
+				{
+					diff = (int32_t)(at(pos + k).seq.load(std::memory_order_acquire) - (pos + k + 1));
+					if (diff != 0)
+					{
+						break;
+					}
+				}
+
+				if (k > 0)
+				{
+					if (m_read.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)	//писатель ещё не записал ячейку
+				{
+					return 0;
+				}
+				else
+				{
+					pos = m_read.load(std::memory_order_relaxed);
+				}
+			}
+
+			for (uint32_t i = 0; i < k; i++)
+			{
+				cell& c = at(pos + i);
+				data[i] = c.data;
+				c.seq.store(pos + i + m_mask + 1, std::memory_order_release);
+			}
+			return (int)k;
+		}
+
+		/**
+		 * @brief Забрать из буфера один элемент (и удалить из буфера)
+		 * @param[out] val данные
+		 * @return число забранных элементов
+		 */
+		inline int pop(_T* val) { return pop(val, 1); }
+
+		//! @brief число эл-в в буфере на момент вызова (приблизительно при одновременных операциях)
+		inline uint32_t size() const
+		{
+			int32_t n = (int32_t)(m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire));
+			return n < 0 ? 0 : (uint32_t)n;
+		}
+
+	private:
+		MpmcRingBuffer(const MpmcRingBuffer<_T>&); // No copy constructor
+
+		struct cell
+		{
+			std::atomic<uint32_t> seq;	///< номер последовательности
+			_T data;
+		};
+
+		inline cell& at(uint32_t pos) { return m_cells[pos & m_mask]; }
+
+		cell* m_cells;
+		uint32_t m_mask;		///< размер - 1
+
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_write;	///< следующая позиция записи
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_read;	///< следующая позиция чтения
+		char m_pad[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
 	};
 
 } // namespace ring_buffer
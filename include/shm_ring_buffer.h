@@ -0,0 +1,515 @@
+/**
+ * @file shm_ring_buffer.h
+ * @author Artem
+ * @brief Кольцевой буфер в разделяемой памяти для обмена между процессами (Linux)
+ * @note Один процесс-писатель и один процесс-читатель. Память - shm_open()/mmap(), в начале заголовок
+ * с атомарными счётчиками записи и чтения, за ним данные. Ожидание данных и места - futex, без опроса:
+ * ожидающая сторона записывает в заголовок нужное число эл-в, другая будит её только когда оно набралось
+ * @version 0.1
+ * @date 2024-09-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+/* Example
+#include "shm_ring_buffer.h"
+// процесс сбора данных
+int producer()
+{
+	ring_buffer::ShmRingBuffer<uint16_t> shm;
+	shm.create("/adc_stream", 1 << 16);
+	uint16_t samples[256];
+	for (;;)
+	{
+		read_adc(samples, 256);
+		shm.wait_for_space(256);
+		shm.put(samples, 256);
+	}
+}
+
+// процесс обработки
+int consumer()
+{
+	ring_buffer::ShmRingBuffer<uint16_t> shm;
+	shm.open("/adc_stream");
+	for (;;)
+	{
+		if (!shm.wait_for_data(1024, 100))	// пакет 1024 эл-та или 100 мс
+			continue;
+		ring_buffer::span_pair<const uint16_t> s = shm.peek_read();	// без копирования
+		process(s.first.data, s.first.size);
+		process(s.second.data, s.second.size);
+		shm.consume(s.size());
+	}
+}
+*/
+
+#ifndef SHM_RING_BUFFER_H
+#define SHM_RING_BUFFER_H
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ring_buffer.h"
+
+namespace ring_buffer
+{
+	namespace detail
+	{
+		static const uint32_t SHM_MAGIC = 0x52425348;	///< "HSBR", заголовок инициализирован
+
+		/**
+		 * @brief Заголовок разделяемой памяти
+		 * @note write и read - счётчики эл-в по модулю 2^32, позиция - счётчик & (capacity - 1)
+		 */
+		struct shm_header
+		{
+			std::atomic<uint32_t> magic;
+			uint32_t elem_size;			///< sizeof(_T) создателя
+			uint32_t capacity;			///< степень 2
+
+			alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> write;	///< меняет писатель, futex читателя
+			std::atomic<uint32_t> read_need;	///< читатель ждёт write - read >= read_need, 0 - не ждёт
+
+			alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> read;	///< меняет читатель, futex писателя
+			std::atomic<uint32_t> write_need;	///< писатель ждёт свободного места >= write_need, 0 - не ждёт
+		};
+
+		/**
+		 * @brief Сон, пока *addr == expected (межпроцессный futex)
+		 * @param timeout_ms таймаут, < 0 - без таймаута
+		 */
+		inline void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected, int timeout_ms)
+		{
+			timespec ts;
+			timespec* pts = nullptr;
+			if (timeout_ms >= 0)
+			{
+				ts.tv_sec = timeout_ms / 1000;
+				ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+				pts = &ts;
+			}
+			syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, pts, nullptr, 0);
+		}
+
+		inline void futex_wake(std::atomic<uint32_t>* addr)
+		{
+			syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+		}
+	}
+
+	/**
+	 * @brief Кольцевой буфер в разделяемой памяти: один писатель и один читатель в разных процессах
+	 * @note put()/try_put()/reserve_write()/commit_write()/wait_for_space() вызывает только писатель,
+	 * get()/pop()/erase()/peek_read()/consume()/wait_for_data() - только читатель.
+	 * _T - тривиально копируемый тип одинакового размера в обоих процессах
+	 */
+	template<typename _T>
+	class ShmRingBuffer
+	{
+		static_assert(std::is_trivially_copyable<_T>::value, "ShmRingBuffer<T>: T must be trivially copyable");
+		static_assert(std::atomic<uint32_t>::is_always_lock_free, "ShmRingBuffer: lock-free 32-bit atomics required");
+
+	public:
+
+		ShmRingBuffer() : m_hdr(nullptr), m_buf(nullptr), m_bytes(0), m_mask(0) {}
+		~ShmRingBuffer() { close(); }
+
+		/**
+		 * @brief Создать (или пересоздать) разделяемую память и буфер в ней
+		 * @note данные прежнего буфера с тем же именем сбрасываются
+		 *
+		 * @param name имя для shm_open(), "/name"
+		 * @param N размер буфера, округляется вверх до степени 2
+		 */
+		void create(const char* name, uint32_t N)
+		{
+			close();
+
+			uint32_t capacity = 1;
+			while (capacity < N)
+			{
+				capacity <<= 1;
+			}
+			size_t bytes = sizeof(detail::shm_header) + (size_t)capacity * sizeof(_T);
+
+			int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+			if (fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "shm_open");
+			}
+			if (ftruncate(fd, bytes) < 0)
+			{
+				int err = errno;
+				::close(fd);
+				throw std::system_error(err, std::generic_category(), "ftruncate");
+			}
+			map(fd, bytes);
+
+			detail::shm_header* hdr = new (m_hdr) detail::shm_header();
+			hdr->elem_size = sizeof(_T);
+			hdr->capacity = capacity;
+			hdr->magic.store(detail::SHM_MAGIC, std::memory_order_release);
+			m_mask = capacity - 1;
+		}
+
+		/**
+		 * @brief Подключиться к буферу, созданному create() в другом процессе
+		 * @param name имя для shm_open()
+		 */
+		void open(const char* name)
+		{
+			close();
+
+			int fd = shm_open(name, O_RDWR, 0);
+			if (fd < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "shm_open");
+			}
+			struct stat st;
+			if (fstat(fd, &st) < 0)
+			{
+				int err = errno;
+				::close(fd);
+				throw std::system_error(err, std::generic_category(), "fstat");
+			}
+			if ((size_t)st.st_size < sizeof(detail::shm_header))
+			{
+				::close(fd);
+				throw std::system_error(EINVAL, std::generic_category(), "ShmRingBuffer: not initialized");
+			}
+			map(fd, (size_t)st.st_size);
+
+			if (m_hdr->magic.load(std::memory_order_acquire) != detail::SHM_MAGIC
+				|| m_hdr->elem_size != sizeof(_T)
+				|| m_bytes != sizeof(detail::shm_header) + (size_t)m_hdr->capacity * sizeof(_T))
+			{
+				close();
+				throw std::system_error(EINVAL, std::generic_category(), "ShmRingBuffer: incompatible buffer");
+			}
+			m_mask = m_hdr->capacity - 1;
+		}
+
+		//! @brief отключиться от памяти, сам буфер остаётся до unlink()
+		void close()
+		{
+			if (m_hdr)
+			{
+				munmap(m_hdr, m_bytes);
+			}
+			m_hdr = nullptr;
+			m_buf = nullptr;
+			m_bytes = 0;
+			m_mask = 0;
+		}
+
+		//! @brief удалить имя разделяемой памяти, подключённые процессы продолжают работать
+		static void unlink(const char* name)
+		{
+			shm_unlink(name);
+		}
+
+		inline uint32_t capacity() const { return m_hdr ? m_mask + 1 : 0; }
+
+		inline uint32_t size() const
+		{
+			check_init();
+			return m_hdr->write.load(std::memory_order_acquire) - m_hdr->read.load(std::memory_order_acquire);
+		}
+
+		/**
+		 * @brief Поместить в буфер все данные или ничего (писатель), без исключений
+		 *
+		 * @param[in] data данные
+		 * @param[in] in_size размер входного массива
+		 * @return false - нет места для in_size эл-в или буфер не инициализирован
+		 */
+		bool try_put(const _T* data, uint32_t in_size)
+		{
+			if (in_size == 0)
+			{
+				return true;
+			}
+			if (!m_hdr)
+			{
+				return false;
+			}
+
+			span_pair<_T> s = reserve_write(in_size);
+			if (s.size() < in_size)
+			{
+				return false;
+			}
+			memcpy(s.first.data, data, s.first.size * sizeof(_T));
+			memcpy(s.second.data, data + s.first.size, s.second.size * sizeof(_T));
+			commit_write(in_size);
+			return true;
+		}
+
+		inline bool try_put(const _T val) { return try_put(&val, 1); }
+
+		/**
+		 * @brief Поместить в буфер новые данные (писатель)
+		 * @note при нехватке места ничего не записывается, исключение OverflowException
+		 *
+		 * @param[in] data данные
+		 * @param[in] in_size размер входного массива
+		 * @return int - код ошибки
+		 */
+		int put(const _T* data, uint32_t in_size)
+		{
+			if (!try_put(data, in_size))
+			{
+				check_init();
+				throw OverflowException("Buffer overflow!!!");
+			}
+			return 0;
+		}
+
+		/**
+		 * @brief Забрать данные из буфера, без удаления их из буфера (читатель)
+		 * @return число реально забранных элементов
+		 */
+		int get(_T* data, uint32_t out_size) const
+		{
+			span_pair<const _T> s = peek_read(out_size);
+			memcpy(data, s.first.data, s.first.size * sizeof(_T));
+			memcpy(data + s.first.size, s.second.data, s.second.size * sizeof(_T));
+			return s.size();
+		}
+
+		/**
+		 * @brief Забрать данные из буфера и удалить их из буфера (читатель)
+		 * @return число реально забранных элементов
+		 */
+		int pop(_T* data, uint32_t out_size)
+		{
+			out_size = get(data, out_size);
+			erase(out_size);
+			return out_size;
+		}
+
+		//! @brief удалить из буфера N элментов (читатель)
+		void erase(uint32_t N)
+		{
+			consume(N);
+		}
+
+		/**
+		 * @brief Место для записи без копирования (писатель), затем commit_write()
+		 * @note Если свободного места меньше n, возвращается всё свободное место
+		 */
+		span_pair<_T> reserve_write(uint32_t n)
+		{
+			check_init();
+			const uint32_t w = m_hdr->write.load(std::memory_order_relaxed);
+			const uint32_t space = (m_mask + 1) - (w - m_hdr->read.load(std::memory_order_acquire));
+			if (n > space)
+			{
+				n = space;
+			}
+			return split(m_buf, w, n);
+		}
+
+		//! @brief Опубликовать n эл-в, записанных в участки reserve_write(), и разбудить читателя
+		void commit_write(uint32_t n)
+		{
+			check_init();
+			const uint32_t w = m_hdr->write.load(std::memory_order_relaxed) + n;
+			const uint32_t r = m_hdr->read.load(std::memory_order_acquire);
+			if (w - r > (m_mask + 1))
+			{
+				throw OverflowException("Buffer overflow!!!");
+			}
+			m_hdr->write.store(w, std::memory_order_release);
+			notify(m_hdr->read_need, m_hdr->write, w - r);
+		}
+
+		/**
+		 * @brief Данные буфера без копирования и без удаления (читатель), удаление - consume()
+		 * @note Если в буфере меньше n эл-в, возвращаются все
+		 */
+		span_pair<const _T> peek_read(uint32_t n = UINT32_MAX) const
+		{
+			check_init();
+			const uint32_t r = m_hdr->read.load(std::memory_order_relaxed);
+			const uint32_t size = m_hdr->write.load(std::memory_order_acquire) - r;
+			if (n > size)
+			{
+				n = size;
+			}
+			return split((const _T*)m_buf, r, n);
+		}
+
+		/**
+		 * @brief Удалить из буфера n эл-в (читатель) и разбудить писателя
+		 * @return число удалённых эл-в
+		 */
+		uint32_t consume(uint32_t n)
+		{
+			check_init();
+			const uint32_t r = m_hdr->read.load(std::memory_order_relaxed);
+			const uint32_t w = m_hdr->write.load(std::memory_order_acquire);
+			if (n > w - r)
+			{
+				n = w - r;
+			}
+			if (n)
+			{
+				m_hdr->read.store(r + n, std::memory_order_release);
+				notify(m_hdr->write_need, m_hdr->read, (m_mask + 1) - (w - r - n));
+			}
+			return n;
+		}
+
+		/**
+		 * @brief Ждать, пока в буфере будет не меньше n эл-в (читатель)
+		 * @note писатель будит читателя один раз, когда набралось n эл-в, а не на каждый put()
+		 *
+		 * @param n число эл-в, не больше capacity()
+		 * @param timeout_ms таймаут, < 0 - без таймаута
+		 * @return false - таймаут
+		 */
+		bool wait_for_data(uint32_t n, int timeout_ms = -1)
+		{
+			check_init();
+			const uint32_t r = m_hdr->read.load(std::memory_order_relaxed);
+			return wait(m_hdr->write, m_hdr->read_need, n, timeout_ms,
+				[r](uint32_t w) { return w - r; });
+		}
+
+		/**
+		 * @brief Ждать, пока в буфере будет не меньше n свободных мест (писатель)
+		 *
+		 * @param n число мест, не больше capacity()
+		 * @param timeout_ms таймаут, < 0 - без таймаута
+		 * @return false - таймаут
+		 */
+		bool wait_for_space(uint32_t n, int timeout_ms = -1)
+		{
+			check_init();
+			const uint32_t w = m_hdr->write.load(std::memory_order_relaxed);
+			const uint32_t capacity = m_mask + 1;
+			return wait(m_hdr->read, m_hdr->write_need, n, timeout_ms,
+				[w, capacity](uint32_t r) { return capacity - (w - r); });
+		}
+
+	private:
+		ShmRingBuffer(const ShmRingBuffer&); // No copy constructor
+
+		//! @brief буфер не создан и не открыт: исключение, как при открытии неинициализированной памяти
+		void check_init() const
+		{
+			if (!m_hdr)
+			{
+				throw std::system_error(EINVAL, std::generic_category(), "ShmRingBuffer: not initialized");
+			}
+		}
+
+		void map(int fd, size_t bytes)
+		{
+			void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			int err = errno;
+			::close(fd);	// отображение держит память
+			if (p == MAP_FAILED)
+			{
+				throw std::system_error(err, std::generic_category(), "mmap");
+			}
+			m_hdr = (detail::shm_header*)p;
+			m_buf = (_T*)((uint8_t*)p + sizeof(detail::shm_header));
+			m_bytes = bytes;
+		}
+
+		//! @brief n эл-в начиная со счётчика pos, с учётом конца памяти
+		template<typename _P>
+		span_pair<_P> split(_P* buf, uint32_t pos, uint32_t n) const
+		{
+			pos &= m_mask;
+			uint32_t n1 = (m_mask + 1) - pos;
+			if (n1 > n)
+			{
+				n1 = n;
+			}
+			span_pair<_P> res = { { buf + pos, n1 }, { buf, n - n1 } };
+			return res;
+		}
+
+		/**
+		 * @brief Разбудить другую сторону, если набралось нужное ей число эл-в
+		 * @param have доступно другой стороне после изменения счётчика
+		 */
+		static void notify(std::atomic<uint32_t>& need, std::atomic<uint32_t>& counter, uint32_t have)
+		{
+			// пара к fence в wait(): либо ожидающий видит новый счётчик, либо здесь видна его заявка
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const uint32_t n = need.load(std::memory_order_relaxed);
+			if (n && have >= n)
+			{
+				detail::futex_wake(&counter);
+			}
+		}
+
+		/**
+		 * @brief Сон на счётчике другой стороны, пока available(счётчик) < n
+		 * @param need заявка для другой стороны
+		 */
+		template<typename _Available>
+		bool wait(std::atomic<uint32_t>& counter, std::atomic<uint32_t>& need, uint32_t n, int timeout_ms, _Available available)
+		{
+			if (n > (m_mask + 1))
+			{
+				n = (m_mask + 1);
+			}
+			if (available(counter.load(std::memory_order_acquire)) >= n)
+			{
+				return true;
+			}
+
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+			bool ready = false;
+			need.store(n, std::memory_order_relaxed);
+			for (;;)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const uint32_t value = counter.load(std::memory_order_acquire);
+				if (available(value) >= n)
+				{
+					ready = true;
+					break;
+				}
+
+				int ms = -1;
+				if (timeout_ms >= 0)
+				{
+					auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+					if (left.count() <= 0)
+					{
+						break;
+					}
+					ms = (int)left.count();
+				}
+				detail::futex_wait(&counter, value, ms);
+			}
+			need.store(0, std::memory_order_relaxed);
+			return ready;
+		}
+
+		detail::shm_header* m_hdr;	///< начало разделяемой памяти
+		_T* m_buf;					///< данные, сразу за заголовком
+		size_t m_bytes;				///< размер отображения
+		uint32_t m_mask;			///< capacity - 1
+	};
+}
+
+#endif // SHM_RING_BUFFER_H
@@ -73,6 +73,7 @@ void io_api::header::parse_file(const std::string& file_input, Calculator<value_
     }
 
     bool active_section = false;
+    std::string script;     //  ,    eval_script()
     while (!ifile.eof())
     {
         std::string str;        
@@ -120,17 +121,16 @@ void io_api::header::parse_file(const std::string& file_input, Calculator<value_
         type_name_list.insert(std::make_pair(name, type));
 #endif
 
-        io_api::header::value_type n = math(sub_str.c_str());
-        if (!n && math.was_error())
-            std::cout << "Error while counting:\r\n\t" << math.error_message();
-        else
-        {
-            //std::cout << name << "= " << n;
-        }
-        //std::cout << "\r\n>";
-
+        script += sub_str;
+        script += '\n';
     }
     ifile.close();
+
+    for (const auto& res : math.eval_script(script.c_str()))
+    {
+        if (res.error != Calculator<value_type>::ERR_NONE)
+            std::cout << "Error while counting:\r\n\t" << err_msgs[res.error];
+    }
 }
 
 void io_api::header::write_file(const std::string& output_dir, const std::string& base_file, const Calculator<value_type>& math)
@@ -152,19 +152,17 @@ void io_api::header::write_file(const std::string& output_dir, const std::string
     
     
     const Calculator<io_api::header::value_type>::itr_range rng = math.list_vars();    
-    std::map<const char*, 
-        io_api::header::value_type, 
-        Calculator<io_api::header::value_type>::compcl>::const_iterator itr;
+    Calculator<io_api::header::value_type>::const_iterator itr;
 
     for (itr = rng.begin; itr != rng.end; itr++)
     {
 #ifndef USE_ONLY_DOUBLE_TYPE        
-        ofile << std::setprecision(16) << "constexpr " << type_name_list.find(itr->first)->second<<" " << PREFIX_VAR << itr->first << " = " << (Type)MATH_FUNC(itr->second) << ";\n";
+        ofile << std::setprecision(16) << "constexpr " << type_name_list.find(itr->first)->second<<" " << PREFIX_VAR << itr->first << " = " << (Type)MATH_FUNC((double)itr->second) << ";\n";
 #else
-        ofile << std::setprecision(16) << "constexpr double " << PREFIX_VAR << itr->first << " = " << MATH_FUNC(itr->second) << ";\n";
+        ofile << std::setprecision(16) << "constexpr double " << PREFIX_VAR << itr->first << " = " << MATH_FUNC((double)itr->second) << ";\n";
 #endif
 #ifdef LOG_ENABLE
-        std::cout << itr->first << " = " << PREFIX_VAR << "(" << itr->second << ") -> " << (Type)MATH_FUNC(itr->second) << "\n";
+        std::cout << itr->first << " = " << PREFIX_VAR << "(" << (double)itr->second << ") -> " << (Type)MATH_FUNC((double)itr->second) << "\n";
 #endif
     }
 
@@ -0,0 +1,174 @@
+#include "calculator.h"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+// выражения, общие для calc_eval() при компиляции, calc_eval() во время выполнения и Calculator<T>
+static constexpr const char* real_exps[] = {
+	"8/3*2", "0.1+0.2", "2^0.5", "2^(0-0.5)", "1.1^50", "10^308", "2^(0-1074)", "2^(0-1075)", "0.7^1000",
+	"(0-2)^3", "(0-2)^0.5", "(0-8)^(1/3)", "0^0", "0^(0-1)", "(0-1)^(0^(0-1))", "0.5^(0^(0-1))", "2^(0^(0-1))",
+	"7.5%2", "(0-7.5)%2", "(0/(0-2))%2", "5%(0-3)", "(0-4)%2", "(0^(0-1))%(0-1)", "99999999999999999999%7", "5%0.5",
+	"123456789.123456789*3", "1.5!", "(0-5)!", "25!", "70!", "(0^(0-1))!", "x = 3.25", "x = 2^10 - 1",
+	"179769313486231570000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+	"000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+	"000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+	"00000000", "0.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001"
+};
+
+static constexpr const char* int_exps[] = {
+	"8/3*2", "(0-7)/2", "7%(0-3)", "(0-7)%3", "2^62 + (2^62 - 1)", "3^39", "20!", "(0-20)!", "2^(0-1)",
+	"(0-1)^(0-3)", "x = 12345678*1000", "3.9 + 2.9", "9007199254740993", "9223372036854775807",
+	"0-9223372036854775807-1", "00000000000000000000000000042.9"
+};
+
+template <typename T, size_t N>
+constexpr std::array<T, N> eval_all(const char* const (&exps)[N])
+{
+	std::array<T, N> r{};
+	for (size_t i = 0; i < N; i++)
+		r[i] = calc_eval<T>(exps[i]);
+	return r;
+}
+
+static constexpr auto real_ct = eval_all<double>(real_exps);
+static constexpr auto int_ct = eval_all<int64_t>(int_exps);
+
+static bool same(double a, double b) { return (a != a && b != b) || std::memcmp(&a, &b, sizeof(a)) == 0; }
+static bool same(int64_t a, int64_t b) { return a == b; }
+
+#ifdef CALC_NO_CONSTANT_EVALUATED
+// calc_eval() во время выполнения считает функциями calc_constexpr: std::pow() и они могут разойтись в последнем знаке
+static bool near(double a, double b)
+{
+	if (same(a, b) || a == b)
+		return true;
+	if (a != a || b != b || (a < 0) != (b < 0))
+		return false;
+	int64_t ia = 0, ib = 0;
+	std::memcpy(&ia, &a, sizeof(a));
+	std::memcpy(&ib, &b, sizeof(b));
+	return ia - ib == 1 || ib - ia == 1;
+}
+#else
+static bool near(double a, double b) { return same(a, b); }
+#endif
+static bool near(int64_t a, int64_t b) { return a == b; }
+
+static void print(const char* exp, double ct, double rt, double calc)
+{
+	printf("%-30.30s %.17g %.17g %.17g\n", exp, ct, rt, calc);
+}
+
+static void print(const char* exp, int64_t ct, int64_t rt, int64_t calc)
+{
+	printf("%-30.30s %lld %lld %lld\n", exp, (long long)ct, (long long)rt, (long long)calc);
+}
+
+template <typename T, size_t N>
+static int check(const char* const (&exps)[N], const std::array<T, N>& ct)
+{
+	int errors = 0;
+	for (size_t i = 0; i < N; i++)
+	{
+		Calculator<T> calc;
+		const T rt = calc_eval<T>(exps[i]);
+		const T value = calc(exps[i]);
+		const bool ok = same(ct[i], value) && near(rt, value);
+		errors += !ok;
+		printf("%s ", ok ? "  " : "!=");
+		print(exps[i], ct[i], rt, value);
+	}
+	return errors;
+}
+
+// случайные выражения: calc_eval() во время выполнения совпадает с Calculator<T>
+template <typename T>
+static int fuzz(unsigned count)
+{
+	static const char* atoms[] = { "0", "1", "2", "3", "0.5", "2.5", "7", "10", "1.1", "99999999999999999999", "x" };
+	static const char* ops[] = { "+", "-", "*", "/", "%", "^" };
+	std::mt19937 rnd(1);
+	int errors = 0;
+	for (unsigned n = 0; n < count; n++)
+	{
+		std::string exp;
+		int depth = 0;
+		for (int k = rnd() % 6 + 1; k > 0; k--)
+		{
+			if (rnd() % 4 == 0)
+				exp += "-";
+			if (rnd() % 3 == 0)
+			{
+				exp += "(";
+				depth++;
+			}
+			exp += atoms[rnd() % (sizeof(atoms) / sizeof(atoms[0]))];
+			if (rnd() % 8 == 0)
+				exp += "!";
+			if (depth && rnd() % 2)
+			{
+				exp += ")";
+				depth--;
+			}
+			if (k > 1)
+				exp += ops[rnd() % (sizeof(ops) / sizeof(ops[0]))];
+		}
+		exp.append(depth, ')');
+
+		Calculator<T> calc;
+		const T rt = calc_eval<T>(exp.c_str());
+		const T value = calc(exp.c_str());
+		if (!near(rt, value))
+		{
+			if (errors++ < 10)
+			{
+				printf("!= ");
+				print(exp.c_str(), rt, rt, value);
+			}
+		}
+	}
+	printf("random %u: %d mismatches\n", count, errors);
+	return errors;
+}
+
+// глубина стека программы не ограничена: 1*x+(2*x+(3*x+...)) с 200 уровнями скобок
+static int deep()
+{
+	std::string exp;
+	for (int i = 1; i <= 200; i++)
+		exp += std::to_string(i) + "*x+(";
+	exp += "x" + std::string(200, ')');
+
+	Calculator<double> calc;
+	calc("x = 2");
+	Calculator<double>::program prog;
+	double x = 2, res[2] = {};
+	double* columns[] = { &x };
+	const double value = calc(exp.c_str());
+	const bool ok = !calc.was_error() && calc.compile(exp.c_str(), prog) && Calculator<double>::optimize(prog);
+	calc.eval_batch(prog, columns, res, 1);
+	const bool same_value = ok && value == 2 * 200 * 201 / 2 + 2 && res[0] == value && calc.eval(prog, &x) == value;
+	printf("%s depth 200: %.17g %.17g\n", same_value ? "  " : "!=", value, res[0]);
+	return !same_value;
+}
+
+int main()
+{
+	printf("   expression                     constexpr runtime Calculator\n");
+	int errors = check(real_exps, real_ct);
+	errors += check(int_exps, int_ct);
+
+	// целое вне диапазона T: ERR_OVER, а не приведение double
+	Calculator<int64_t> calc;
+	const int64_t big = calc("9223372036854775808");
+	const bool over = calc.error_code() == Calculator<int64_t>::ERR_OVER;
+	printf("%s 9223372036854775808: %lld, ERR_OVER %d\n", over ? "  " : "!=", (long long)big, over);
+	errors += !over;
+
+	errors += deep();
+	errors += fuzz<double>(20000);
+	errors += fuzz<int64_t>(20000);
+	return errors != 0;
+}
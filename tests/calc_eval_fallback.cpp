@@ -0,0 +1,3 @@
+// calc_eval() на компиляторе без std::is_constant_evaluated(): во время выполнения - функции calc_constexpr
+#define CALC_NO_CONSTANT_EVALUATED
+#include "calc_eval.cpp"
@@ -0,0 +1,104 @@
+#include "calculator.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const char* valid_exp[] = {
+	"a = 8",
+	"b = 3",
+	"c = a / b",
+	"(a + b) * c - 2^3",
+	"-a + b % 2 + 3!",
+};
+
+static const char* invalid_exp[] = {
+	"(a + b * c",		// ERR_BAL
+	"a * b +",			// ERR_END
+	"a * / b",			// ERR_OP
+	"a + b $ c",		// ERR_UNKNOWN
+	"2 = 3",			// ERR_OP
+};
+
+template<int N>
+static double bench(Calculator<double>& calc, const char* (&list)[N], int iterations, int& errors)
+{
+	errors = 0;
+	double sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		for (int j = 0; j < N; j++)
+		{
+			sum += calc(list[j]);
+			errors += calc.was_error();
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	if (sum == 1.2345) printf(" ");	// результат не выбрасывается оптимизатором
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / ((double)iterations * N);
+}
+
+// разбор длинной формулы: 200 слагаемых с длинными именами переменных
+static double bench_long(Calculator<double>& calc, int iterations)
+{
+	std::string exp = "result = ";
+	for (int i = 0; i < 200; i++)
+	{
+		exp += "sensorvalue";
+		exp += (char)('a' + i % 26);
+		exp += " * 1.2345 + ";
+	}
+	exp += "3.14159";
+
+	Calculator<double>::program prog;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		calc.compile(exp.c_str(), prog);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+// сетка a = 0..1 с шагом 1e-3 x b = 1..100
+static double bench_sweep(Calculator<double>& calc, size_t& count)
+{
+	typedef Calculator<double>::axis axis;
+	const axis axes[] = { axis::range("a", 0, 1, 1e-3), axis::range("b", 1, 100, 1) };
+	std::vector<double> out(axes[0].count * axes[1].count);
+
+	Calculator<double>::program prog;
+	calc.compile("a*a*b - b/(a + 1)", prog);
+	auto start = std::chrono::steady_clock::now();
+	count = calc.sweep(prog, axes, 2, out.data());
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main()
+{
+	const int iterations = 200000;
+	Calculator<double> calc;
+	int errors;
+
+	double t = bench(calc, valid_exp, iterations, errors);
+	printf("valid:   %8.1f ns/exp, errors= %d\n", t, errors);
+
+	t = bench(calc, invalid_exp, iterations, errors);
+	printf("invalid: %8.1f ns/exp, errors= %d\n", t, errors);
+
+	calc.set_cache_size(16);
+	t = bench(calc, valid_exp, iterations, errors);
+	printf("cached:  %8.1f ns/exp, errors= %d, hits= %llu, misses= %llu\n", t, errors,
+		(unsigned long long)calc.cache_hits(), (unsigned long long)calc.cache_misses());
+
+	t = bench_long(calc, iterations / 20);
+	printf("long:    %8.1f us/compile\n", t);
+
+	size_t count;
+	t = bench_sweep(calc, count);
+	printf("sweep:   %8.1f ns/value, values= %zu\n", t, count);
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include "calculator_jit.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static const char* formulas[] = {
+	"a*b + c",
+	"(a + b) * (a - b) / (c + 1)",
+	"x = (a*3 - b)*(a*3 - b) + c^2 - a%7",
+};
+
+template<typename T, typename F>
+static double bench(F&& eval, T* slots, int iterations)
+{
+	T sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		slots[0] = (T)i;
+		sum += eval(slots);
+	}
+	auto end = std::chrono::steady_clock::now();
+	if (sum == (T)12345) printf(" ");	// результат не выбрасывается оптимизатором
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+template<typename T>
+static void run(const char* type_name, int iterations)
+{
+	Calculator<T> calc;
+	for (const char* exp : formulas)
+	{
+		typename Calculator<T>::program prog;
+		calc.compile(exp, prog);
+		Calculator<T>::optimize(prog);
+
+		CalculatorJit<T> jit;
+		bool native = jit.compile(prog);
+
+		T slots[4] = { 1, 2, 3, 4 };
+		double t_int = bench([&](T* s) { return calc.eval(prog, s); }, slots, iterations);
+		double t_jit = bench([&](T* s) { return jit(s); }, slots, iterations);
+
+		printf("%-8s %-40s interpreter: %6.1f ns, jit%s: %6.1f ns\n",
+			type_name, exp, t_int, native ? "" : " (fallback)", t_jit);
+	}
+}
+
+// одна функция в двух потоках: у каждого свой флаг ошибки, чужое деление на 0 не видно
+static int shared_errors(int iterations)
+{
+	Calculator<int64_t> calc;
+	Calculator<int64_t>::program prog;
+	calc.compile("a%b + a/b", prog);	// остаток - вызов, деление - код
+	CalculatorJit<int64_t> jit;
+	jit.compile(prog);
+
+	int wrong[2] = { 0, 0 };
+	auto worker = [&](int id)
+	{
+		int64_t slots[2] = { 7, id };	// поток 0 делит на 0
+		for (int i = 0; i < iterations; i++)
+		{
+			bool error = false;
+			jit(slots, error);
+			wrong[id] += error != (id == 0);
+		}
+	};
+	std::thread other(worker, 1);
+	worker(0);
+	other.join();
+	printf("shared jit: wrong error flags %d\n", wrong[0] + wrong[1]);
+	return wrong[0] + wrong[1];
+}
+
+int main()
+{
+	const int iterations = 5000000;
+	run<double>("double", iterations);
+	run<int64_t>("int64_t", iterations);
+	return shared_errors(iterations) != 0;
+}
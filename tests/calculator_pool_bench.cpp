@@ -0,0 +1,47 @@
+#include "calculator_pool.h"
+#include <chrono>
+#include <cstdio>
+
+int main()
+{
+	Calculator<double> calc;
+	calc("a = 1.5");
+	calc("b = 2.25");
+	calc("c = 3");
+
+	// независимые выражения над общими переменными
+	std::vector<std::string> exps;
+	for (int i = 0; i < 50000; i++)
+	{
+		exps.push_back("(a*" + std::to_string(i % 97) + " + b)^2 / (c + " + std::to_string(i) + ") - a%3");
+		if (i % 1000 == 0)
+			exps.push_back("a * (b");	// ошибка разбора
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	double sum_seq = 0;
+	for (const std::string& exp : exps)
+		sum_seq += calc(exp.c_str());
+	double t_seq = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("sequential:  %7.1f ms\n", t_seq);
+
+	const unsigned threads[] = { 1, 2, 4, 8, std::thread::hardware_concurrency() };
+	for (unsigned n : threads)
+	{
+		CalculatorPool<double> pool(n);
+		start = std::chrono::steady_clock::now();
+		std::vector<CalculatorPool<double>::result> res = pool.eval(calc, exps);
+		double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		double sum = 0;
+		int errors = 0;
+		for (const auto& r : res)
+		{
+			sum += r.value;
+			errors += r.error != Calculator<double>::ERR_NONE;
+		}
+		printf("threads %2u:  %7.1f ms, speedup %4.2f, errors= %d, same= %d\n",
+			pool.size(), t, t_seq / t, errors, sum == sum_seq);
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include "math/fixed_point.h"
+#include <chrono>
+#include <cstdio>
+
+static const char* formulas[] = {
+	"a*b + c",
+	"(a + b) * (a - b) / (c + 1)",
+	"x = (a*3 - b)*(a*3 - b) + c^2 - a%7",
+};
+
+template<typename T>
+static double bench(Calculator<T>& calc, const typename Calculator<T>::program& prog, int iterations, double& result)
+{
+	T slots[4] = { T(1.25), T(2.5), T(3.75), T(0) };
+	double sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		slots[0] = T(i % 100);
+		sum += (double)calc.eval(prog, slots);
+	}
+	auto end = std::chrono::steady_clock::now();
+	result = sum / iterations;	// результат не выбрасывается оптимизатором
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+template<typename T>
+static void run(const char* type_name, int iterations)
+{
+	Calculator<T> calc;
+	for (const char* exp : formulas)
+	{
+		typename Calculator<T>::program prog;
+		calc.compile(exp, prog);
+
+		double mean;
+		double t = bench(calc, prog, iterations, mean);
+		printf("%-14s %-40s %6.1f ns, mean= %.6f\n", type_name, exp, t, mean);
+	}
+}
+
+int main()
+{
+	const int iterations = 5000000;
+	run<double>("double", iterations);
+	run<math::fixed_point<15, 16>>("fixed<15,16>", iterations);
+	run<math::fixed_point<31, 32>>("fixed<31,32>", iterations);
+	return 0;
+}
@@ -1,5 +1,8 @@
 
 #include "ring_buffer.h"
+#include <chrono>
+#include <string>
+#include <thread>
 typedef uint8_t Type;
 int main()
 {
@@ -34,5 +37,129 @@ int main()
 	}
 
 	delete buf;
+
+	// запись и чтение без копирования: участки до и после конца памяти
+	ring_buffer::RingBuffer<Type, 8> spans;
+	spans.put(data, 6);
+	spans.erase(6);
+	ring_buffer::span_pair<Type> w = spans.reserve_write(5);
+	for (uint32_t i = 0; i < w.first.size; i++)
+		w.first.data[i] = data[i];
+	for (uint32_t i = 0; i < w.second.size; i++)
+		w.second.data[i] = data[w.first.size + i];
+	spans.commit_write(w.size());
+	ring_buffer::span_pair<const Type> r = spans.peek_read();
+	printf("peek: %u + %u:", r.first.size, r.second.size);
+	for (uint32_t i = 0; i < r.first.size; i++)
+		printf(" %d", r.first.data[i]);
+	for (uint32_t i = 0; i < r.second.size; i++)
+		printf(" %d", r.second.data[i]);
+	uint32_t k = spans.consume(3);
+	printf(", consume %u, size= %u\n", k, spans.size());
+
+	// телеметрия: при переполнении вытесняются самые старые отсчёты
+	ring_buffer::RingBuffer<uint16_t, 4, ring_buffer::e_overflow_overwrite> telemetry;
+	for (uint16_t i = 0; i < 10; i++)
+		telemetry.put(i);
+	uint16_t last[4];
+	int cnt = telemetry.pop(last, 4);
+	printf("telemetry: %d %d %d %d (%d), dropped= %llu\n", last[0], last[1], last[2], last[3], cnt,
+		(unsigned long long)telemetry.dropped());
+
+	ring_buffer::RingBuffer<uint16_t, 4, ring_buffer::e_overflow_reject> lossy;
+	int code = lossy.put(last, 4);
+	code = lossy.put(last, 1) == ring_buffer::e_err_overflow && code == ring_buffer::e_success;
+	printf("reject: %s, dropped= %llu\n", code ? "ok" : "FAIL", (unsigned long long)lossy.dropped());
+	ring_buffer::RingBuffer<uint16_t, 4, ring_buffer::e_overflow_reject> pending;
+	pending.put(last, 2);
+	int moved = lossy.copy(&pending, 2);	// не поместились, но остались в pending: не потеряны
+	printf("reject copy: moved= %d, left= %u, dropped= %llu\n", moved, pending.size(), (unsigned long long)lossy.dropped());
+
+	// сообщения перемещаются в буфер и из буфера без копирования данных строк
+	ring_buffer::RingBuffer<std::string, 4> messages;
+	std::string msg = "frame #1: 0123456789 0123456789 0123456789";
+	messages.put(std::move(msg));
+	messages.emplace("frame #2");
+	std::string out;
+	messages.pop(&out);
+	printf("messages: '%s', left %u\n", out.c_str(), messages.size());
+
+#ifdef __linux__
+	// кадр через конец памяти - один непрерывный участок
+	ring_buffer::MirroredRingBuffer<uint16_t> mirror;
+	mirror.init(100);
+	uint32_t cap = mirror.capacity();
+	for (uint32_t i = 0; i < cap - 3; i++)
+		mirror.put((uint16_t)i);
+	mirror.erase(cap - 3);
+	for (uint16_t i = 0; i < 6; i++)
+		mirror.put(i);
+	ring_buffer::span_pair<const uint16_t> frame = mirror.peek_read();
+	printf("mirror: capacity= %u, frame %u + %u:", cap, frame.first.size, frame.second.size);
+	for (uint32_t i = 0; i < frame.first.size; i++)
+		printf(" %d", frame.first.data[i]);
+	printf("\n");
+#endif
+
+	// один писатель и один читатель в разных потоках
+	const uint32_t count = 1000000;
+	ring_buffer::SpscRingBuffer<uint32_t> spsc;
+	spsc.init(256);
+	auto start = std::chrono::steady_clock::now();
+	std::thread reader([&]()
+		{
+			uint64_t sum = 0;
+			uint32_t chunk[32];
+			for (uint32_t n = 0; n < count; )
+			{
+				int k = spsc.pop(chunk, 32);
+				if (k == 0)
+					std::this_thread::yield();	// писатель может ждать того же ядра
+				for (int i = 0; i < k; i++)
+					sum += chunk[i];
+				n += k;
+			}
+			printf("spsc sum= %llu, expected= %llu\n", (unsigned long long)sum, (unsigned long long)count * (count - 1) / 2);
+		});
+	for (uint32_t i = 0; i < count; )
+	{
+		if (spsc.size() < 256)	// место освобождает только читатель
+			spsc.put(i++);
+		else
+			std::this_thread::yield();
+	}
+	reader.join();
+	auto end = std::chrono::steady_clock::now();
+	printf("spsc polling: %.0f ms\n", std::chrono::duration<double, std::milli>(end - start).count());
+
+	// блокирующее ожидание: читатель спит до пакета из 64 эл-в, писатель - до места под пакет
+	ring_buffer::SpscRingBuffer<uint32_t, ring_buffer::e_overflow_block> blocking;
+	if (blocking.wait_for_data(1) || blocking.wait_for_space(1))	// до init() - сразу false
+		printf("spsc wait before init: expected false\n");
+	blocking.init(256);
+	start = std::chrono::steady_clock::now();
+	std::thread sleeper([&]()
+		{
+			uint64_t sum = 0;
+			uint32_t chunk[64];
+			for (uint32_t n = 0; n < count; )
+			{
+				int k = blocking.pop_wait(chunk, 64, 100, 64);	// остаток - по таймауту
+				for (int i = 0; i < k; i++)
+					sum += chunk[i];
+				n += k;
+			}
+			printf("spsc wait sum= %llu, expected= %llu\n", (unsigned long long)sum, (unsigned long long)count * (count - 1) / 2);
+		});
+	uint32_t batch[10];
+	for (uint32_t i = 0; i < count; i += 10)
+	{
+		for (uint32_t k = 0; k < 10; k++)
+			batch[k] = i + k;
+		blocking.put_wait(batch, 10);
+	}
+	sleeper.join();
+	end = std::chrono::steady_clock::now();
+	printf("spsc waiting: %.0f ms\n", std::chrono::duration<double, std::milli>(end - start).count());
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "ring_buffer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t items = 1 << 20;	// всего эл-в через очередь
+static const uint32_t capacity = 1024;
+
+// очередь с общим мьютексом для сравнения
+struct LockedQueue
+{
+	std::mutex lock;
+	ring_buffer::RingBuffer<uint32_t> buf;
+
+	bool try_put(const uint32_t* data, uint32_t n)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (capacity - buf.size() < n)
+			return false;
+		buf.put(data, n);
+		return true;
+	}
+
+	int pop(uint32_t* data, uint32_t n)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return buf.pop(data, n);
+	}
+};
+
+/**
+ * @brief threads писателей и threads читателей, эл-ты пакетами по batch
+ * @return нс на эл-т, sum - сумма прочитанных значений
+ */
+template<typename Queue>
+static double bench(Queue& queue, unsigned threads, uint32_t batch, uint64_t& sum)
+{
+	std::atomic<uint64_t> total(0);
+	std::atomic<uint32_t> consumed(0);
+	std::vector<std::thread> pool;
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned t = 0; t < threads; t++)
+	{
+		pool.emplace_back([&, t]()
+			{
+				uint32_t data[64];
+				for (uint32_t i = t * batch; i < items; i += threads * batch)
+				{
+					uint32_t n = items - i < batch ? items - i : batch;
+					for (uint32_t k = 0; k < n; k++)
+						data[k] = i + k;
+					while (!queue.try_put(data, n))
+						std::this_thread::yield();
+				}
+			});
+		pool.emplace_back([&]()
+			{
+				uint32_t data[64];
+				uint64_t local = 0;
+				while (consumed.load(std::memory_order_relaxed) < items)
+				{
+					int n = queue.pop(data, batch);
+					if (!n)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					for (int k = 0; k < n; k++)
+						local += data[k];
+					consumed.fetch_add(n, std::memory_order_relaxed);
+				}
+				total.fetch_add(local);
+			});
+	}
+	for (std::thread& th : pool)
+		th.join();
+	auto end = std::chrono::steady_clock::now();
+
+	sum = total.load();
+	return std::chrono::duration<double, std::nano>(end - start).count() / items;
+}
+
+/**
+ * @brief Однопоточный put/pop по одному эл-ту
+ * @return нс на эл-т
+ */
+template<typename Buffer>
+static double bench_single(Buffer& buf, uint64_t& sum)
+{
+	uint32_t val = 0;
+	sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < items; i += 3)
+	{
+		// заполнение на 3 эл-та, чтобы индексы проходили всю ёмкость
+		buf.put(i);
+		buf.put(i + 1);
+		buf.put(i + 2);
+		for (int k = 0; k < 3; k++)
+		{
+			buf.pop(&val);
+			sum += val;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / (items / 3 * 3);
+}
+
+/**
+ * @brief Однопоточный put/pop кадрами по frame эл-в, кадры пересекают конец памяти
+ * @return нс на эл-т
+ */
+template<typename Buffer>
+static double bench_frames(Buffer& buf, uint32_t frame, uint64_t& sum)
+{
+	uint32_t data[64];
+	for (uint32_t k = 0; k < frame; k++)
+		data[k] = k;
+	sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < items; i += frame)
+	{
+		buf.put(data, frame);
+		buf.pop(data, frame);
+		sum += data[frame - 1];
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / items;
+}
+
+/**
+ * @brief Однопоточный put/pop сообщений std::vector копированием или перемещением
+ * @return нс на сообщение
+ */
+static double bench_messages(bool move, uint64_t& sum)
+{
+	ring_buffer::RingBuffer<std::vector<uint32_t>> buf;
+	buf.init(capacity);
+	std::vector<uint32_t> msg, out;
+	const uint32_t count = items / 64;
+	sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		msg.assign(256, i);
+		if (move)
+			buf.put(std::move(msg));
+		else
+			buf.put(msg);
+		buf.pop(&out);
+		sum += out[255];
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+/**
+ * @brief put() в заполненный буфер: цена пути переполнения
+ * @return нс на put()
+ */
+template<ring_buffer::e_overflow_t _Overflow>
+static double bench_overflow(uint32_t count, uint64_t& dropped)
+{
+	ring_buffer::RingBuffer<uint32_t, capacity, _Overflow> buf;
+	for (uint32_t i = 0; i < capacity; i++)
+		buf.put(i);
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		try
+		{
+			buf.put(i);
+		}
+		catch (const ring_buffer::OverflowException&)
+		{
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	dropped = buf.dropped();
+	return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main()
+{
+	{
+		uint64_t sum_dyn, sum_fix;
+		ring_buffer::RingBuffer<uint32_t> dyn;
+		dyn.init(capacity);
+		ring_buffer::RingBuffer<uint32_t, capacity> fixed;
+		double t_dyn = bench_single(dyn, sum_dyn);
+		double t_fix = bench_single(fixed, sum_fix);
+		printf("single thread: RingBuffer<T> %5.2f ns/item, RingBuffer<T, %u> %5.2f ns/item%s\n",
+			t_dyn, capacity, t_fix, sum_dyn == sum_fix ? "" : "  SUM MISMATCH");
+	}
+	{
+		uint64_t sum_copy, sum_move;
+		double t_copy = bench_messages(false, sum_copy);
+		double t_move = bench_messages(true, sum_move);
+		printf("vector<uint32_t>(256) messages: put(const T&) %6.1f ns/msg, put(T&&) %6.1f ns/msg%s\n",
+			t_copy, t_move, sum_copy == sum_move ? "" : "  SUM MISMATCH");
+	}
+	{
+		uint64_t d_throw, d_reject, d_over;
+		double t_throw = bench_overflow<ring_buffer::e_overflow_throw>(items / 16, d_throw);
+		double t_reject = bench_overflow<ring_buffer::e_overflow_reject>(items, d_reject);
+		double t_over = bench_overflow<ring_buffer::e_overflow_overwrite>(items, d_over);
+		printf("put into full buffer: throw %7.1f ns, reject %5.2f ns, overwrite %5.2f ns%s\n", t_throw, t_reject, t_over,
+			d_throw == items / 16 && d_reject == items && d_over == items ? "" : "  DROPPED MISMATCH");
+	}
+#ifdef __linux__
+	{
+		uint64_t sum_dyn, sum_mirror;
+		ring_buffer::RingBuffer<uint32_t> dyn;
+		dyn.init(capacity);
+		ring_buffer::MirroredRingBuffer<uint32_t> mirror;
+		mirror.init(capacity);
+		double t_dyn = bench_frames(dyn, 48, sum_dyn);
+		double t_mirror = bench_frames(mirror, 48, sum_mirror);
+		printf("frames of 48: RingBuffer<T> %5.2f ns/item, MirroredRingBuffer<T> %5.2f ns/item%s\n",
+			t_dyn, t_mirror, sum_dyn == sum_mirror ? "" : "  SUM MISMATCH");
+	}
+#endif
+
+	const uint64_t expected = (uint64_t)items * (items - 1) / 2;
+	unsigned max_threads = std::thread::hardware_concurrency();
+	if (max_threads < 4)
+		max_threads = 4;
+
+	for (uint32_t batch : { 1u, 16u })
+	{
+		for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+		{
+			uint64_t sum_mpmc, sum_lock;
+
+			ring_buffer::MpmcRingBuffer<uint32_t> mpmc;
+			mpmc.init(capacity);
+			double t_mpmc = bench(mpmc, threads, batch, sum_mpmc);
+
+			LockedQueue locked;
+			locked.buf.init(capacity);
+			double t_lock = bench(locked, threads, batch, sum_lock);
+
+			printf("batch %2u, %2u+%-2u threads: mpmc %6.1f ns/item, mutex %6.1f ns/item%s\n", batch, threads, threads,
+				t_mpmc, t_lock, sum_mpmc == expected && sum_lock == expected ? "" : "  SUM MISMATCH");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include "shm_ring_buffer.h"
+#include <sys/wait.h>
+
+// писатель и читатель в разных процессах
+int main()
+{
+	const uint32_t count = 1 << 24;
+	const uint32_t batch = 256;
+	char name[64];
+	snprintf(name, sizeof(name), "/ring_buffer_test_%d", (int)getpid());
+
+	ring_buffer::ShmRingBuffer<uint32_t> shm;
+	try
+	{
+		shm.size();
+		printf("shm size before create: expected exception\n");
+	}
+	catch (const std::system_error&)
+	{
+	}
+	if (shm.try_put(1))
+		printf("shm try_put before create: expected false\n");
+
+	// try_put() при нехватке места: false без исключения, буфер не меняется
+	shm.create(name, 4);
+	uint32_t full[4] = { 1, 2, 3, 4 };
+	if (!shm.try_put(full, 4) || shm.try_put(5) || shm.size() != 4)
+		printf("shm try_put on full buffer: expected false, size 4\n");
+
+	shm.create(name, 1 << 14);
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		ring_buffer::ShmRingBuffer<uint32_t> reader;
+		reader.open(name);
+		uint64_t sum = 0;
+		uint32_t batches = 0;
+		for (uint32_t n = 0; n < count; )
+		{
+			// пакет или остаток после таймаута
+			batches += reader.wait_for_data(4 * batch, 10) ? 1 : 0;
+			ring_buffer::span_pair<const uint32_t> s = reader.peek_read();
+			for (uint32_t i = 0; i < s.first.size; i++)
+				sum += s.first.data[i];
+			for (uint32_t i = 0; i < s.second.size; i++)
+				sum += s.second.data[i];
+			n += reader.consume(s.size());
+		}
+		printf("shm sum= %llu, expected= %llu, full batches= %u\n", (unsigned long long)sum,
+			(unsigned long long)count * (count - 1) / 2, batches);
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	uint32_t data[batch];
+	for (uint32_t i = 0; i < count; i += batch)
+	{
+		for (uint32_t k = 0; k < batch; k++)
+			data[k] = i + k;
+		shm.wait_for_space(batch);
+		shm.put(data, batch);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	auto end = std::chrono::steady_clock::now();
+	double sec = std::chrono::duration<double>(end - start).count();
+	printf("shm: %u items in %.3f s, %.0f MB/s\n", count, sec, count * sizeof(uint32_t) / sec / 1e6);
+
+	ring_buffer::ShmRingBuffer<uint32_t>::unlink(name);
+	return 0;
+}